@@ -1,8 +1,7 @@
 #include "ads7138.h"
 
-#include <driver/i2c.h>
-
 #include "registers.h"
+#include "../cores.h"
 
 /* @brief tag used for ESP serial console messages */
 static const char TAG[] = "ADS7138";
@@ -13,25 +12,12 @@ constexpr auto ads7138_i2c_num = I2C_NUM_1;
 constexpr uint8_t ads7138_i2c_address = 0x11;  // R2 11k to GND
 constexpr uint32_t ads7138_timeout_ms = 100;
 
-constexpr i2c_config_t ads7138_i2c_config = {
-    .mode = I2C_MODE_MASTER,
-    .sda_io_num = 26,
-    .scl_io_num = 27,
-    .sda_pullup_en = GPIO_PULLUP_ENABLE,
-    .scl_pullup_en = GPIO_PULLUP_ENABLE,
-    .master =
-        {
-            .clk_speed = 400000,
-        },
-    .clk_flags = 0, // optional; you can use I2C_SCLK_SRC_FLAG_* flags to choose i2c source clock here
-};
-
 void ads7138_init()
 {
     ESP_LOGI(TAG, "Init start!");
 
-    ESP_ERROR_CHECK(i2c_param_config(ads7138_i2c_num, &ads7138_i2c_config));
-    ESP_ERROR_CHECK(i2c_driver_install(ads7138_i2c_num, ads7138_i2c_config.mode, 0, 0, 0));
+    /* shared with mpu6500, installed by whichever starts first */
+    ESP_ERROR_CHECK(i2c_bus_init(ads7138_i2c_num));
 
     vTaskDelay(pdMS_TO_TICKS(100));
 
@@ -50,7 +36,7 @@ void ads7138_init()
     /* start wifi manager task */
     ESP_LOGI(TAG, "IMU Task started!");
 
-    xTaskCreate(&ads7138_task, "ads7138_task", 4096, NULL, 10, &ads7138_task_handle);
+    xTaskCreatePinnedToCore(&ads7138_task, "ads7138_task", 4096, NULL, 10, &ads7138_task_handle, CORE_CONTROL);
 }
 
 /**
@@ -64,7 +50,7 @@ void ads7138_task(void* pvParameters)
 
     while (1)
         {
-            ads7138_read_data(RECENT_CH0_LSB, (uint8_t*)&data, sizeof(data));
+            ads7138_read_data(RECENT_CH0_LSB, (uint8_t*)&data, sizeof(data), I2C_BUS_BACKGROUND);
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
 
@@ -80,15 +66,9 @@ void ads7138_task(void* pvParameters)
  */
 void ads7138_write_data(const uint8_t* data, uint32_t length)
 {
-    auto cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (ads7138_i2c_address << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, SINGLE_REG_WRITE, true);
-    i2c_master_write_byte(cmd, data[0], true);
-    i2c_master_write(cmd, data + 1, length - 1, true);
-    i2c_master_stop(cmd);
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(ads7138_i2c_num, cmd, pdMS_TO_TICKS(ads7138_timeout_ms)));
-    i2c_cmd_link_delete(cmd);
+    const uint8_t opcode = SINGLE_REG_WRITE;
+    ESP_ERROR_CHECK(i2c_bus_write(ads7138_i2c_num, ads7138_i2c_address, &opcode, 1, data, length, ads7138_timeout_ms,
+                                  I2C_BUS_BACKGROUND));
 }
 
 /**
@@ -97,18 +77,11 @@ void ads7138_write_data(const uint8_t* data, uint32_t length)
  * @param register_address
  * @param data
  * @param length
+ * @param priority I2C_BUS_BACKGROUND outside of the control loop
  */
-void ads7138_read_data(uint8_t register_address, uint8_t* data, uint32_t length)
+void ads7138_read_data(uint8_t register_address, uint8_t* data, uint32_t length, I2cBusPriority priority)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (ads7138_i2c_address << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, READ_CONTINOUS, true);
-    i2c_master_write_byte(cmd, register_address, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (ads7138_i2c_address << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(cmd, data, length, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(ads7138_i2c_num, cmd, pdMS_TO_TICKS(ads7138_timeout_ms)));
-    i2c_cmd_link_delete(cmd);
+    const uint8_t prefix[] = {READ_CONTINOUS, register_address};
+    ESP_ERROR_CHECK(i2c_bus_read(ads7138_i2c_num, ads7138_i2c_address, prefix, sizeof(prefix), data, length, ads7138_timeout_ms,
+                                 priority));
 }
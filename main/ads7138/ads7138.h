@@ -7,6 +7,8 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "../i2c_bus/i2c_bus.h"
+
 struct __attribute__((packed)) ads7138_struct
 {
     uint16_t ain[8];
@@ -15,4 +17,5 @@ struct __attribute__((packed)) ads7138_struct
 void ads7138_init();
 void ads7138_task(void* pvParameters);
 void ads7138_write_data(const uint8_t* data, uint32_t length);
-void ads7138_read_data(uint8_t register_address, uint8_t* data, uint32_t length);
+void ads7138_read_data(uint8_t register_address, uint8_t* data, uint32_t length,
+                       I2cBusPriority priority = I2C_BUS_CONTROL);
@@ -7,6 +7,8 @@
 #include <driver/spi_master.h>
 #include <hal/spi_types.h>
 
+#include "../i2c_bus/i2c_bus.h"
+#include "../logging/trace_log.h"
 #include "../utils.h"
 #include "as5055.h"
 #include "register.h"
@@ -53,11 +55,21 @@ constexpr static spi_device_interface_config_t device_config = {
     .post_cb = NULL,                            //Specify pre-transfer callback to handle D/C line
 };
 
-/** Main initialization function of the sensor */
-void as5055_init() {
+/**
+ * Main initialization function of the sensor
+ *
+ * @return false if its pins are taken, on current board by I2C_NUM_1
+ */
+bool as5055_init() {
+    const int pins[] = {bus_config.mosi_io_num, bus_config.miso_io_num, bus_config.sclk_io_num,
+                        device_config.spics_io_num};
+    if (!i2c_bus_claim_pins("as5055", pins, sizeof(pins) / sizeof(pins[0]))) {
+        return false;
+    }
     //Initialize the SPI bus
     ESP_ERROR_CHECK(spi_bus_initialize(AS5055_SPI_BUS, &bus_config, SPI_DMA_DISABLED));
     ESP_ERROR_CHECK(spi_bus_add_device(AS5055_SPI_BUS, &device_config, &spi_handle));
+    return true;
 }
 
 void as5055_clear_error() {
@@ -85,7 +97,10 @@ float as5055_convert_angle(uint16_t data) {
 
 /** Main sensor Task - read output data from Enkoder read Angle */
 void as5055_test_task(void* pvParameters) {
-    as5055_init();
+    trace_log_init();
+    if (!as5055_init()) {
+        vTaskDelete(NULL);
+    }
 
     float angle = 0;
 
@@ -102,8 +117,8 @@ void as5055_test_task(void* pvParameters) {
             angle = as5055_convert_angle(data);
         }
 
-        ESP_LOGI(TAG, "Angle hex %x", data);
-        ESP_LOGI(TAG, "Angle: %f", angle);
+        TRACE_LOGI(TAG, "Angle hex %x", data);
+        TRACE_LOGI(TAG, "Angle: %f", angle);
     }
     vTaskDelete(NULL);
 }
@@ -111,6 +126,7 @@ void as5055_test_task(void* pvParameters) {
 /** Main sensor Task - read output data from Enkoder AGC value */ //TODO: validate
 void as5055_test_task_AGC(void* pvParameters)
  {
+    trace_log_init();
 
     uint16_t data = 0x00;
     uint16_t agc = 0;
@@ -140,7 +156,7 @@ void as5055_test_task_AGC(void* pvParameters)
             agc = (data >> 2) & 0x3f;
         }
 
-        ESP_LOGI(TAG, "AGC: %u", agc);
+        TRACE_LOGI(TAG, "AGC: %u", agc);
 
     }
     vTaskDelete(NULL);
@@ -2,7 +2,7 @@
 
 #include <cstdint>
 
-void as5055_init();
+bool as5055_init();
 void as5055_clear_error();
 void as5055_soft_reset();
 void as5055_test_task(void* pvParameters);
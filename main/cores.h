@@ -0,0 +1,9 @@
+#pragma once
+
+/**
+ * Task pinning layout. Everything that may block or run long (radio, lwIP,
+ * httpd, FATFS, log formatting) is on PRO_CPU, so APP_CPU only does sensor
+ * bus transactions and control math and keeps its deadlines.
+ */
+#define CORE_SYSTEM 0   // PRO_CPU
+#define CORE_CONTROL 1  // APP_CPU
@@ -48,7 +48,8 @@ void http_app_start()
     if (httpd_handle == NULL)
     {
         httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-        config.max_uri_handlers = 20; // Zwiększam ilość możliwych endopointów
+        config.max_uri_handlers = 32; // Zwiększam ilość możliwych endopointów
+        config.core_id = CORE_SYSTEM; // control loop has APP_CPU for itself
 
         /* this is an important option that isn't set up by default.
          * We could register all URLs one by one, but this would not work while
@@ -62,6 +63,7 @@ void http_app_start()
             ESP_LOGI(TAG, "Registering URI handlers");
             register_wifi_http_handlers(httpd_handle);
             register_read_files_http_handlers(httpd_handle);
+            register_control_http_handlers(httpd_handle);
             register_webpage_handlers(httpd_handle);
             register_flasher_http_handlers(httpd_handle);
             ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &http_server_hw_api_request));
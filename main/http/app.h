@@ -11,7 +11,9 @@
 
 #include "../hardware/Init.h"
 #include "../hardware/hardware_command.h"
+#include "../cores.h"
 #include "../wifi/wifi_manager.h"
+#include "controlapp/control_app.h"
 #include "esp_http_server.h"
 #include "flasher/flasher.h"
 #include "readfiles/read_files.h"
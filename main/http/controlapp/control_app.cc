@@ -0,0 +1,384 @@
+#include "control_app.h"
+
+/* @brief tag used for ESP serial console messages */
+static constexpr char TAG[] = "control_app";
+
+/* Line sensor calibration sweep request */
+struct LineCalibrationDescr {
+    uint32_t duration_ms = LINE_CALIBRATION_DEFAULT_MS;
+};
+
+/* POST starts the sweep (empty body - default duration), GET returns state */
+esp_err_t line_calibration_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            uint8_t data[sizeof(LineCalibrationDescr)];
+            auto post_size = get_post_data(req, data, sizeof(data));
+            LineCalibrationDescr descr;
+            if (post_size) {
+                descr = extract_struct<LineCalibrationDescr>(data, post_size);
+            }
+            if (descr.duration_ms > LINE_CALIBRATION_MAX_MS) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Calibration too long.");
+            }
+            if (!line_calibration_start(descr.duration_ms)) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Calibration already running.");
+            }
+            ESP_LOGI(TAG, "Line calibration requested");
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        auto cal = line_calibration_data();
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_DICT(
+                JSON_KEY(state, (uint32_t)line_calibration_state());
+                JSON_KEY(samples, cal.samples);
+                JSON_SUBKEY(min, JSON_LIST(
+                    for (auto v : cal.min) {
+                        JSON_ELEM((uint32_t)v);
+                    }
+                ));
+                JSON_SUBKEY(max, JSON_LIST(
+                    for (auto v : cal.max) {
+                        JSON_ELEM((uint32_t)v);
+                    }
+                ));
+            )
+        );
+    );
+}
+
+/* POST takes raw LineFollowerSettings (autotune.e output), GET returns them */
+esp_err_t line_follower_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            uint8_t data[sizeof(LineFollowerSettings)];
+            auto post_size = get_post_data(req, data, sizeof(data));
+            auto& settings = extract_struct<LineFollowerSettings>(data, post_size);
+            if (!line_follower_settings_valid(settings)) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Invalid line follower settings.");
+            }
+            if (!line_follower_set_settings(settings)) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Previous settings not applied yet.");
+            }
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        auto settings = line_follower_get_settings();
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_DICT(
+                JSON_KEY(base_duty, settings.base_duty);
+                JSON_KEY(lost_base_scale, settings.lost_base_scale);
+                JSON_SUBKEY(steering, JSON_DICT(
+                    JSON_KEY(kaw, settings.steering.kaw[0]);
+                    JSON_KEY(tf, settings.steering.tf[0]);
+                    JSON_KEY(out_min, settings.steering.out_min[0]);
+                    JSON_KEY(out_max, settings.steering.out_max[0]);
+                ));
+                JSON_SUBKEY(schedule, JSON_LIST(
+                    for (uint32_t k = 0; k < LF_SCHEDULE_POINTS; k++) {
+                        auto g = line_follower_gains(settings.steering, k);
+                        JSON_SUBELEM(JSON_DICT(
+                            JSON_KEY(base_duty, g.base_duty);
+                            JSON_KEY(kp, g.kp);
+                            JSON_KEY(ki, g.ki);
+                            JSON_KEY(kd, g.kd);
+                        ));
+                    }
+                ));
+            )
+        );
+    );
+}
+
+/* POST starts relay experiment (empty body - defaults), GET returns result */
+esp_err_t autotune_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            uint8_t data[sizeof(RelayTunerSettings)];
+            auto post_size = get_post_data(req, data, sizeof(data));
+            RelayTunerSettings settings;
+            if (post_size) {
+                settings = extract_struct<RelayTunerSettings>(data, post_size);
+            }
+            // written as !(valid) to refuse NaN too
+            if (settings.periods < 1 || !(settings.amplitude > 0) || !(settings.hysteresis >= 0) ||
+                !(settings.timeout_s > 0) || !std::isfinite(settings.base_duty)) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Invalid autotune settings.");
+            }
+            if (!line_follower_autotune(settings)) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Autotune already running.");
+            }
+            ESP_LOGI(TAG, "Relay autotune requested");
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        auto tuner = line_follower_tuner();
+        auto gains = relay_tuner_gains(tuner);
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_DICT(
+                JSON_KEY(state, (uint32_t)tuner.state);
+                JSON_KEY(periods, tuner.periods);
+                JSON_KEY(ku, tuner.ku);
+                JSON_KEY(tu, tuner.tu);
+                JSON_KEY(kp, gains.kp);
+                JSON_KEY(ki, gains.ki);
+                JSON_KEY(kd, gains.kd);
+            )
+        );
+    );
+}
+
+/* POST switches LineFollowerMode (uint32_t body), GET returns it */
+esp_err_t line_mode_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            uint8_t data[sizeof(uint32_t)];
+            auto post_size = get_post_data(req, data, sizeof(data));
+            auto new_mode = extract_struct<uint32_t>(data, post_size);
+            if (new_mode > LF_MODE_RACE) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Unknown mode.");
+            }
+            if (!line_follower_set_mode((LineFollowerMode)new_mode)) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Mode not changed, race needs encoder and track map.");
+            }
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_DICT(
+                JSON_KEY(mode, (uint32_t)line_follower_mode());
+            )
+        );
+    );
+}
+
+/**
+ * POST with raw SpeedProfileSettings builds the map from the last learning
+ * lap, empty body loads the saved one. GET returns the map.
+ */
+esp_err_t track_map_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            uint8_t data[sizeof(SpeedProfileSettings)];
+            auto post_size = get_post_data(req, data, sizeof(data));
+            if (post_size) {
+                auto& profile = extract_struct<SpeedProfileSettings>(data, post_size);
+                if (!line_follower_build_map(profile)) {
+                    throw HttpException(HTTPD_400_BAD_REQUEST, "Track map not built, finish learning lap first.");
+                }
+            } else if (!line_follower_load_map()) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Track map not loaded.");
+            }
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        auto& map = line_follower_map();
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_DICT(
+                JSON_KEY(length, map.length);
+                JSON_SUBKEY(segments, JSON_LIST(
+                    for (uint32_t k = 0; k < map.segments; k++) {
+                        auto& s = map.segment[k];
+                        JSON_SUBELEM(JSON_DICT(
+                            JSON_KEY(start, s.start);
+                            JSON_KEY(length, s.length);
+                            JSON_KEY(curvature, s.curvature);
+                            JSON_KEY(v_limit, s.v_limit);
+                            JSON_KEY(v_entry, s.v_entry);
+                        ));
+                    }
+                ));
+            )
+        );
+    );
+}
+
+/* POST starts the motor sweep (no body), GET returns state and the table */
+esp_err_t motor_calibration_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            if (!line_follower_calibrate_motors()) {
+                throw HttpException(HTTPD_400_BAD_REQUEST, "Motor sweep or autotune already running.");
+            }
+            ESP_LOGI(TAG, "Motor calibration requested");
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        auto lut = motors_lut();
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_DICT(
+                JSON_KEY(state, (uint32_t)motor_calibration_state());
+                JSON_KEY(version, lut.version);
+                JSON_KEY(battery_v, lut.battery_v);
+                JSON_SUBKEY(duty, JSON_LIST(
+                    for (uint32_t k = 0; k < MOTOR_LUT_POINTS; k++) {
+                        JSON_ELEM(motor_lut_point_duty(k));
+                    }
+                ));
+                JSON_SUBKEY(speed, JSON_LIST(
+                    for (auto& motor : lut.speed) {
+                        JSON_SUBELEM(JSON_LIST(
+                            for (auto v : motor) {
+                                JSON_ELEM(v);
+                            }
+                        ));
+                    }
+                ));
+            )
+        );
+    );
+}
+
+/* POST resets bus statistics, GET returns them for every I2C port */
+esp_err_t i2c_bus_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        if (req->method == HTTP_POST) {
+            for (int port = 0; port < I2C_NUM_MAX; port++) {
+                i2c_bus_reset_stats((i2c_port_t)port);
+            }
+            httpd_resp_send(req, NULL, 0);
+            return ESP_OK;
+        }
+
+        httpd_resp_set_type(req, http_content_type_json);
+        httpd_resp_set_hdr(req, http_cache_control_hdr, http_cache_control_no_cache);
+        JSON_TO_HTTP(req,
+            JSON_LIST(
+                for (int port = 0; port < I2C_NUM_MAX; port++) {
+                    auto s = i2c_bus_get_stats((i2c_port_t)port);
+                    JSON_SUBELEM(JSON_DICT(
+                        JSON_KEY(port, (uint32_t)port);
+                        JSON_KEY(utilization, s.utilization);
+                        JSON_KEY(busy_us, (double)s.busy_us);
+                        JSON_KEY(elapsed_us, (double)s.elapsed_us);
+                        JSON_KEY(errors, s.errors);
+                        JSON_KEY(control, s.transactions[I2C_BUS_CONTROL]);
+                        JSON_KEY(background, s.transactions[I2C_BUS_BACKGROUND]);
+                        JSON_KEY(control_wait_max_us, s.wait_max_us[I2C_BUS_CONTROL]);
+                        JSON_KEY(background_wait_max_us, s.wait_max_us[I2C_BUS_BACKGROUND]);
+                    ));
+                }
+            )
+        );
+    );
+}
+
+static constexpr httpd_uri_t line_calibration_request_post_descr = {
+    .uri = "/line_calibration", .method = HTTP_POST,
+    .handler = line_calibration_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t line_calibration_request_get_descr = {
+    .uri = "/line_calibration", .method = HTTP_GET,
+    .handler = line_calibration_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t line_follower_request_post_descr = {
+    .uri = "/line_follower", .method = HTTP_POST,
+    .handler = line_follower_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t line_follower_request_get_descr = {
+    .uri = "/line_follower", .method = HTTP_GET,
+    .handler = line_follower_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t autotune_request_post_descr = {
+    .uri = "/autotune", .method = HTTP_POST,
+    .handler = autotune_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t autotune_request_get_descr = {
+    .uri = "/autotune", .method = HTTP_GET,
+    .handler = autotune_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t line_mode_request_post_descr = {
+    .uri = "/line_mode", .method = HTTP_POST,
+    .handler = line_mode_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t line_mode_request_get_descr = {
+    .uri = "/line_mode", .method = HTTP_GET,
+    .handler = line_mode_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t track_map_request_post_descr = {
+    .uri = "/track_map", .method = HTTP_POST,
+    .handler = track_map_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t track_map_request_get_descr = {
+    .uri = "/track_map", .method = HTTP_GET,
+    .handler = track_map_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t motor_calibration_request_post_descr = {
+    .uri = "/motor_calibration", .method = HTTP_POST,
+    .handler = motor_calibration_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t motor_calibration_request_get_descr = {
+    .uri = "/motor_calibration", .method = HTTP_GET,
+    .handler = motor_calibration_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t i2c_bus_request_post_descr = {
+    .uri = "/i2c_bus", .method = HTTP_POST,
+    .handler = i2c_bus_http_handler,
+    .user_ctx = NULL
+};
+
+static constexpr httpd_uri_t i2c_bus_request_get_descr = {
+    .uri = "/i2c_bus", .method = HTTP_GET,
+    .handler = i2c_bus_http_handler,
+    .user_ctx = NULL
+};
+
+void register_control_http_handlers(httpd_handle_t httpd_handle) {
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &line_calibration_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &line_calibration_request_get_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &line_follower_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &line_follower_request_get_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &autotune_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &autotune_request_get_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &line_mode_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &line_mode_request_get_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &track_map_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &track_map_request_get_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &motor_calibration_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &motor_calibration_request_get_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &i2c_bus_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &i2c_bus_request_get_descr));
+}
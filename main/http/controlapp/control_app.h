@@ -0,0 +1,16 @@
+#pragma once
+
+#include <esp_http_server.h>
+
+#include <cmath>
+#include <cstdint>
+
+#include "../../i2c_bus/i2c_bus.h"
+#include "../../lf-control/control.h"
+#include "../../lf-control/line_calibration.h"
+#include "../../lf-control/motor_calibration.h"
+#include "../../motors/motors.h"
+#include "../json.h"
+#include "../utils.h"
+
+void register_control_http_handlers(httpd_handle_t httpd_handle);
@@ -51,6 +51,137 @@ esp_err_t read_file_http_handler(httpd_req_t* req) {
     );
 }
 
+/* Time window of .blog segment, esp_timer time in us like LogIndexEntry */
+struct LogWindowDescr {
+    int64_t from_us = 0;
+    int64_t to_us = INT64_MAX;
+};
+
+/* Send part of the file through the buffer */
+static void send_file_range(httpd_req_t* req, FILE* F, uint32_t start, uint32_t end,
+                            uint8_t* data, uint32_t buffer_size) {
+    fseek(F, start, SEEK_SET);
+    while (start < end) {
+        auto to_read = end - start < buffer_size ? end - start : buffer_size;
+        auto data_read = fread(data, 1, to_read, F);
+        if (data_read <= 0) break;
+
+        httpd_resp_send_chunk(req, (char*)data, data_read);
+        start += data_read;
+    }
+}
+
+/**
+ * To use POST method, client sends LogWindowDescr. Response is valid .blog file:
+ * header, schemas declared before the window and records from the index entry
+ * before from_us to the first index entry after to_us (delta streams start
+ * with keyframes there), so it is enough to read .bidx and seek.
+ */
+esp_err_t read_log_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        constexpr static uint32_t buffer_size = 1024;
+        uint8_t data[buffer_size];
+
+        auto post_size = get_post_data(req, data, buffer_size);
+        LogWindowDescr window;
+        if (post_size) {
+            window = extract_struct<LogWindowDescr>(data, post_size);
+        }
+
+        // uri starts with `/read_log` -> length 9, index is .bidx next to .blog
+        char fname[128];
+        snprintf(fname, sizeof(fname) - 2, "%s%s", base_path, req->uri + 9);
+        auto ext = strrchr(fname, '.');
+        if (unlikely(!ext || strcmp(ext, ".blog"))) {
+            throw HttpException(HTTPD_400_BAD_REQUEST, "Not a .blog file.");
+        }
+
+        uint32_t schemas[LOG_MAX_STREAMS];
+        uint32_t schemas_count = 0;
+        uint32_t start = 0;
+        uint32_t end = UINT32_MAX;
+
+        strcpy(ext, ".bidx");
+        auto I = fopen(fname, "rb");
+        if (unlikely(!I)) {
+            throw HttpException(HTTPD_404_NOT_FOUND, "Opening index failed.");
+        }
+        LogIndexEntry entry;
+        while (fread(&entry, sizeof(entry), 1, I) == 1) {
+            if (entry.flags & LOG_INDEX_SCHEMA) {
+                if (schemas_count < LOG_MAX_STREAMS) {
+                    schemas[schemas_count++] = entry.offset;
+                }
+            } else if (entry.timestamp_us <= window.from_us) {
+                start = entry.offset;
+            } else if (entry.timestamp_us > window.to_us) {
+                end = entry.offset;
+                break;
+            }
+        }
+        fclose(I);
+
+        strcpy(ext, ".blog");
+        ESP_LOGI(TAG, "Opening log %s", fname);
+        auto F = fopen(fname, "rb");
+        if (unlikely(!F)) {
+            throw HttpException(HTTPD_400_BAD_REQUEST, "Opening file failed.");
+        }
+
+        LogFileHeader header;
+        if (fread(&header, sizeof(header), 1, F) != 1) {
+            fclose(F);
+            throw HttpException(HTTPD_400_BAD_REQUEST, "Invalid log header.");
+        }
+        if (start < header.header_size) {
+            start = header.header_size;
+        }
+        send_file_range(req, F, 0, header.header_size, data, buffer_size);
+
+        // schemas inside the window are sent with the records,
+        // in framed file (version 3) schema has own blocks
+        bool framed = header.version >= 3;
+        for (uint32_t i = 0; i < schemas_count && schemas[i] < start; i++) {
+            LogSchemaDecl decl;
+            fseek(F, schemas[i] + (framed ? sizeof(LogBlockHeader) : 0), SEEK_SET);
+            if (fread(&decl, sizeof(decl), 1, F) != 1) break;
+            uint32_t size = sizeof(decl) + decl.name_size + decl.json_descr_size;
+            if (framed) {
+                size = (size + LOG_BLOCK_PAYLOAD - 1) / LOG_BLOCK_PAYLOAD * LOG_BLOCK_SIZE;
+            }
+            send_file_range(req, F, schemas[i], schemas[i] + size, data, buffer_size);
+        }
+
+        send_file_range(req, F, start, end, data, buffer_size);
+
+        httpd_resp_send_chunk(req, NULL, 0);
+        fclose(F);
+    );
+}
+
+/* Flight recorder control, mode is LogMode */
+struct LogControlDescr {
+    uint8_t mode = LOG_MODE_CONTINUOUS;
+    uint8_t trigger = 0;
+};
+
+esp_err_t log_control_http_handler(httpd_req_t* req) {
+    HTTP_HANDLER_GUARD(
+        uint8_t data[sizeof(LogControlDescr)];
+        auto post_size = get_post_data(req, data, sizeof(data));
+        auto& control = extract_struct<LogControlDescr>(data, post_size);
+        if (control.mode > LOG_MODE_FLIGHT_RECORDER) {
+            throw HttpException(HTTPD_400_BAD_REQUEST, "Unknown log mode.");
+        }
+
+        log_set_mode((LogMode)control.mode);
+        if (control.trigger) {
+            log_trigger();
+        }
+        httpd_resp_send(req, NULL, 0);
+    );
+}
+
 esp_err_t list_files_http_handler(httpd_req_t* req) {
     HTTP_HANDLER_GUARD(
         constexpr static uint32_t buffer_size = 256;
@@ -91,6 +222,18 @@ static constexpr httpd_uri_t read_file_request_post_descr = {
     .handler = read_file_http_handler, 
     .user_ctx = NULL
 };
+/* Records of .blog file in time window */
+static constexpr httpd_uri_t read_log_request_post_descr = {
+    .uri = "/read_log/*", .method = HTTP_POST,
+    .handler = read_log_http_handler,
+    .user_ctx = NULL
+};
+/* Switch flight recorder and trigger saving of its window */
+static constexpr httpd_uri_t log_control_request_post_descr = {
+    .uri = "/log_control", .method = HTTP_POST,
+    .handler = log_control_http_handler,
+    .user_ctx = NULL
+};
 /* Basic list of files name */
 static constexpr httpd_uri_t list_files_request_get_descr = {
     .uri = "/list_files/*", .method = HTTP_GET,
@@ -101,5 +244,7 @@ static constexpr httpd_uri_t list_files_request_get_descr = {
 void register_read_files_http_handlers(httpd_handle_t httpd_handle) {
     ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &read_file_request_get_descr));
     ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &read_file_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &read_log_request_post_descr));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &log_control_request_post_descr));
     ESP_ERROR_CHECK(httpd_register_uri_handler(httpd_handle, &list_files_request_get_descr));
 }
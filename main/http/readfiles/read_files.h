@@ -7,6 +7,7 @@
 
 #include <cstdint>
 
+#include "../../logging/sd_logger.h"
 #include "../json.h"
 #include "../utils.h"
 
@@ -0,0 +1,124 @@
+#pragma once
+/**
+ * Host stand-in for the legacy ESP-IDF I2C master command link API, for
+ * benchmarks of code using i2c_transaction.h. Allocates like the IDF driver: a
+ * dynamic link takes one malloc for the link and one for every command, a
+ * static link carves commands out of the given buffer.
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+
+typedef uint32_t TickType_t;
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+typedef int i2c_port_t;
+#define I2C_NUM_0 0
+#define I2C_NUM_1 1
+
+enum i2c_rw_t { I2C_MASTER_WRITE = 0, I2C_MASTER_READ = 1 };
+enum i2c_ack_type_t { I2C_MASTER_ACK, I2C_MASTER_NACK, I2C_MASTER_LAST_NACK };
+
+struct i2c_host_cmd_t {
+    uint8_t* read;  // NULL for start, stop and writes
+    size_t length;
+    i2c_host_cmd_t* next;
+};
+
+struct i2c_host_link_t {
+    i2c_host_cmd_t* head;
+    i2c_host_cmd_t* tail;
+    uint8_t* free;  // static link: next command in the buffer
+    uint8_t* end;
+};
+
+typedef i2c_host_link_t* i2c_cmd_handle_t;
+
+#define I2C_INTERNAL_STRUCT_SIZE (sizeof(i2c_host_cmd_t))
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS) \
+    (2 * I2C_INTERNAL_STRUCT_SIZE + I2C_INTERNAL_STRUCT_SIZE * (5 * (TRANSACTIONS)))
+
+inline i2c_cmd_handle_t i2c_cmd_link_create() {
+    return (i2c_cmd_handle_t)calloc(1, sizeof(i2c_host_link_t));
+}
+
+inline i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t* buffer, uint32_t size) {
+    if (size < sizeof(i2c_host_link_t)) {
+        return NULL;
+    }
+    auto link = (i2c_cmd_handle_t)buffer;
+    *link = {NULL, NULL, buffer + sizeof(i2c_host_link_t), buffer + size};
+    return link;
+}
+
+inline void i2c_cmd_link_delete(i2c_cmd_handle_t link) {
+    while (link->head) {
+        auto next = link->head->next;
+        free(link->head);
+        link->head = next;
+    }
+    free(link);
+}
+
+inline void i2c_cmd_link_delete_static(i2c_cmd_handle_t) {}
+
+inline esp_err_t i2c_host_add(i2c_cmd_handle_t link, uint8_t* read, size_t length) {
+    if (link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_host_cmd_t* cmd;
+    if (link->end) {
+        if (link->free + sizeof(i2c_host_cmd_t) > link->end) {
+            return ESP_ERR_NO_MEM;
+        }
+        cmd = (i2c_host_cmd_t*)link->free;
+        link->free += sizeof(i2c_host_cmd_t);
+    } else {
+        cmd = (i2c_host_cmd_t*)malloc(sizeof(i2c_host_cmd_t));
+    }
+    *cmd = {read, length, NULL};
+    (link->tail ? link->tail->next : link->head) = cmd;
+    link->tail = cmd;
+    return ESP_OK;
+}
+
+inline esp_err_t i2c_master_start(i2c_cmd_handle_t link) {
+    return i2c_host_add(link, NULL, 0);
+}
+
+inline esp_err_t i2c_master_stop(i2c_cmd_handle_t link) {
+    return i2c_host_add(link, NULL, 0);
+}
+
+inline esp_err_t i2c_master_write_byte(i2c_cmd_handle_t link, uint8_t, bool) {
+    return i2c_host_add(link, NULL, 1);
+}
+
+inline esp_err_t i2c_master_write(i2c_cmd_handle_t link, const uint8_t*, size_t length, bool) {
+    return i2c_host_add(link, NULL, length);
+}
+
+/* LAST_NACK is two commands in the IDF driver */
+inline esp_err_t i2c_master_read(i2c_cmd_handle_t link, uint8_t* data, size_t length, i2c_ack_type_t ack) {
+    if (ack == I2C_MASTER_LAST_NACK && length > 1) {
+        auto err = i2c_host_add(link, data, length - 1);
+        return err == ESP_OK ? i2c_host_add(link, data + length - 1, 1) : err;
+    }
+    return i2c_host_add(link, data, length);
+}
+
+/* Reads return 0xa5 bytes */
+inline esp_err_t i2c_master_cmd_begin(i2c_port_t, i2c_cmd_handle_t link, TickType_t) {
+    for (auto cmd = link->head; cmd; cmd = cmd->next) {
+        if (cmd->read) {
+            memset(cmd->read, 0xa5, cmd->length);
+        }
+    }
+    return ESP_OK;
+}
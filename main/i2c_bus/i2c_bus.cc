@@ -0,0 +1,341 @@
+/* Shared I2C buses: installed once, transactions scheduled by priority */
+#include "i2c_bus.h"
+
+#include <esp_compiler.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstring>
+
+static const char TAG[] = "i2c_bus";
+
+static constexpr I2cBusConfig i2c_bus_configs[] = {
+    {I2C_NUM_0, 32, 33, 500000},  // camera
+    {I2C_NUM_1, 26, 27, 400000},  // ads7138, mpu6500
+};
+
+static const char* const i2c_bus_names[] = {"I2C_NUM_0", "I2C_NUM_1"};
+
+enum I2cBusState : uint8_t
+{
+    I2C_BUS_NONE,
+    I2C_BUS_INSTALLING,
+    I2C_BUS_READY,
+    I2C_BUS_FAILED,
+};
+
+struct I2cBus
+{
+    std::atomic<uint8_t> state{I2C_BUS_NONE};
+    /* control transactions blocked on the mutex, background ones wait */
+    std::atomic<uint32_t> control_waiting{0};
+    StaticSemaphore_t mutex_buffer;
+    SemaphoreHandle_t mutex;
+    /* written with mutex held */
+    I2cBusStats stats;
+    int64_t stats_start_us;
+    volatile bool stats_reset;
+};
+
+static I2cBus buses[I2C_NUM_MAX];
+
+/* GPIOs taken by buses and other drivers sharing them (as5055 SPI) */
+#define I2C_BUS_MAX_PINS 16
+struct ClaimedPin
+{
+    int pin;
+    const char* owner;
+};
+static ClaimedPin claimed_pins[I2C_BUS_MAX_PINS];
+static uint32_t claimed_count = 0;
+static portMUX_TYPE claim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Take GPIOs for a bus or a driver, all or none
+ *
+ * @param owner name for the log, the same owner may claim again
+ * @return false if a pin belongs to another owner
+ */
+bool i2c_bus_claim_pins(const char* owner, const int* pins, uint32_t count)
+{
+    const ClaimedPin* conflict = NULL;
+    bool full = false;
+    taskENTER_CRITICAL(&claim_lock);
+    for (uint32_t k = 0; k < count && !conflict; k++)
+    {
+        for (uint32_t c = 0; c < claimed_count; c++)
+        {
+            if (claimed_pins[c].pin == pins[k]
+                && strcmp(claimed_pins[c].owner, owner) != 0)
+            {
+                conflict = &claimed_pins[c];
+                break;
+            }
+        }
+    }
+    full = claimed_count + count > I2C_BUS_MAX_PINS;
+    if (!conflict && !full)
+    {
+        for (uint32_t k = 0; k < count; k++)
+        {
+            claimed_pins[claimed_count++] = {pins[k], owner};
+        }
+    }
+    taskEXIT_CRITICAL(&claim_lock);
+
+    if (conflict)
+    {
+        ESP_LOGE(
+            TAG,
+            "%s: GPIO %d already used by %s",
+            owner,
+            conflict->pin,
+            conflict->owner);
+    }
+    else if (full)
+    {
+        ESP_LOGE(TAG, "%s: too many claimed pins", owner);
+    }
+    return !conflict && !full;
+}
+
+/**
+ * @brief Install the bus with its board configuration, called by every
+ * driver on the bus - the first one installs, the others wait for it
+ */
+esp_err_t i2c_bus_init(i2c_port_t port)
+{
+    const I2cBusConfig* config = NULL;
+    for (auto& c : i2c_bus_configs)
+    {
+        config = c.port == port ? &c : config;
+    }
+    if (!config)
+    {
+        ESP_LOGE(TAG, "No configuration of I2C port %d", port);
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto& bus = buses[port];
+    uint8_t expected = I2C_BUS_NONE;
+    if (!bus.state.compare_exchange_strong(expected, I2C_BUS_INSTALLING))
+    {
+        while (bus.state.load() == I2C_BUS_INSTALLING)
+        {
+            vTaskDelay(1);
+        }
+        return bus.state.load() == I2C_BUS_READY ? ESP_OK : ESP_FAIL;
+    }
+
+    esp_err_t err = ESP_FAIL;
+    const int pins[] = {config->sda, config->scl};
+    if (i2c_bus_claim_pins(i2c_bus_names[port], pins, 2))
+    {
+        i2c_config_t i2c_config = {};
+        i2c_config.mode = I2C_MODE_MASTER;
+        i2c_config.sda_io_num = config->sda;
+        i2c_config.scl_io_num = config->scl;
+        i2c_config.sda_pullup_en = GPIO_PULLUP_ENABLE;
+        i2c_config.scl_pullup_en = GPIO_PULLUP_ENABLE;
+        i2c_config.master.clk_speed = config->clk_speed;
+        err = i2c_param_config(port, &i2c_config);
+        if (err == ESP_OK)
+        {
+            err = i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0);
+        }
+    }
+    if (err == ESP_OK)
+    {
+        bus.mutex = xSemaphoreCreateMutexStatic(&bus.mutex_buffer);
+        bus.stats = {};
+        bus.stats_start_us = esp_timer_get_time();
+        ESP_LOGI(
+            TAG,
+            "%s installed, SDA %d SCL %d",
+            i2c_bus_names[port],
+            config->sda,
+            config->scl);
+    }
+    else
+    {
+        ESP_LOGE(
+            TAG,
+            "%s install failed: %s",
+            i2c_bus_names[port],
+            esp_err_to_name(err));
+    }
+    bus.state.store(err == ESP_OK ? I2C_BUS_READY : I2C_BUS_FAILED);
+    return err;
+}
+
+/**
+ * @brief Take the bus, background transactions wait while control ones are
+ * queued and give the bus back if one came while they were blocked
+ *
+ * @return time waited [us], -1 on timeout
+ */
+static int64_t i2c_bus_lock(
+    I2cBus& bus,
+    I2cBusPriority priority,
+    uint32_t timeout_ms)
+{
+    int64_t start_us = esp_timer_get_time();
+    if (likely(priority == I2C_BUS_CONTROL))
+    {
+        bus.control_waiting.fetch_add(1);
+        bool locked = xSemaphoreTake(bus.mutex, pdMS_TO_TICKS(timeout_ms));
+        bus.control_waiting.fetch_sub(1);
+        return locked ? esp_timer_get_time() - start_us : -1;
+    }
+
+    int64_t deadline_us = start_us + timeout_ms * 1000LL;
+    while (1)
+    {
+        if (bus.control_waiting.load() == 0)
+        {
+            int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+            if (xSemaphoreTake(
+                    bus.mutex, pdMS_TO_TICKS(left_ms > 0 ? left_ms : 0)))
+            {
+                if (bus.control_waiting.load() == 0)
+                {
+                    return esp_timer_get_time() - start_us;
+                }
+                xSemaphoreGive(bus.mutex);
+            }
+        }
+        if (esp_timer_get_time() >= deadline_us)
+        {
+            return -1;
+        }
+        vTaskDelay(1);
+    }
+}
+
+/* Transaction with the bus taken, accounted in stats */
+template <typename Transaction>
+static esp_err_t i2c_bus_run(
+    i2c_port_t port,
+    I2cBusPriority priority,
+    uint32_t timeout_ms,
+    Transaction transaction)
+{
+    auto& bus = buses[port];
+    if (unlikely(bus.state.load(std::memory_order_acquire) != I2C_BUS_READY))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t wait_us = i2c_bus_lock(bus, priority, timeout_ms);
+    if (unlikely(wait_us < 0))
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    auto err = transaction();
+    int64_t end_us = esp_timer_get_time();
+
+    auto& s = bus.stats;
+    if (unlikely(bus.stats_reset))
+    {
+        s = {};
+        bus.stats_start_us = start_us;
+        bus.stats_reset = false;
+    }
+    s.transactions[priority]++;
+    s.errors += err != ESP_OK;
+    s.busy_us += end_us - start_us;
+    if (wait_us > s.wait_max_us[priority])
+    {
+        s.wait_max_us[priority] = wait_us;
+    }
+    xSemaphoreGive(bus.mutex);
+    return err;
+}
+
+/**
+ * @brief Write prefix (register address, command) and data in one
+ * transaction
+ *
+ * @param priority I2C_BUS_BACKGROUND for configuration
+ */
+esp_err_t i2c_bus_write(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    const uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms,
+    I2cBusPriority priority)
+{
+    return i2c_bus_run(
+        port,
+        priority,
+        timeout_ms,
+        [&]
+        {
+            return i2c_transaction_write(
+                port,
+                address,
+                prefix,
+                prefix_length,
+                data,
+                length,
+                timeout_ms);
+        });
+}
+
+/**
+ * @brief Write prefix, then read data after repeated start. Without prefix
+ * only the read phase is sent.
+ *
+ * @param priority I2C_BUS_CONTROL for reads of the control loop
+ */
+esp_err_t i2c_bus_read(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms,
+    I2cBusPriority priority)
+{
+    return i2c_bus_run(
+        port,
+        priority,
+        timeout_ms,
+        [&]
+        {
+            return i2c_transaction_read(
+                port,
+                address,
+                prefix,
+                prefix_length,
+                data,
+                length,
+                timeout_ms);
+        });
+}
+
+/* Copy for reporting, may be torn by a transaction */
+I2cBusStats i2c_bus_get_stats(i2c_port_t port)
+{
+    auto& bus = buses[port];
+    if (bus.state.load(std::memory_order_acquire) != I2C_BUS_READY)
+    {
+        return {};
+    }
+    auto stats = bus.stats;
+    stats.elapsed_us = esp_timer_get_time() - bus.stats_start_us;
+    stats.utilization =
+        stats.elapsed_us ? float(stats.busy_us) / stats.elapsed_us : 0;
+    return stats;
+}
+
+/* Done by the next transaction on the bus */
+void i2c_bus_reset_stats(i2c_port_t port) { buses[port].stats_reset = true; }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <driver/i2c.h>
+
+#include <cstdint>
+
+#include "i2c_transaction.h"
+
+/**
+ * Every physical bus is installed once by the first driver calling
+ * i2c_bus_init() and shared by all devices on it. Control transactions
+ * (sensor frame reads) go before waiting background ones (configuration,
+ * test tasks), so they wait for at most one transaction in progress.
+ */
+enum I2cBusPriority : uint8_t
+{
+    I2C_BUS_CONTROL,
+    I2C_BUS_BACKGROUND,
+    I2C_BUS_PRIORITIES
+};
+
+/* Pins and clock of the buses on the board */
+struct I2cBusConfig
+{
+    i2c_port_t port;
+    int sda;
+    int scl;
+    uint32_t clk_speed;
+};
+
+struct I2cBusStats
+{
+    uint32_t transactions[I2C_BUS_PRIORITIES];
+    uint32_t errors;
+    uint32_t wait_max_us[I2C_BUS_PRIORITIES];  // for the bus, not the device
+    uint64_t busy_us;     // transactions on the wire
+    uint64_t elapsed_us;  // since install or reset
+    float utilization;    // busy_us / elapsed_us
+};
+
+esp_err_t i2c_bus_init(i2c_port_t port);
+bool i2c_bus_claim_pins(const char* owner, const int* pins, uint32_t count);
+esp_err_t i2c_bus_write(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    const uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms,
+    I2cBusPriority priority = I2C_BUS_CONTROL);
+esp_err_t i2c_bus_read(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms,
+    I2cBusPriority priority = I2C_BUS_CONTROL);
+I2cBusStats i2c_bus_get_stats(i2c_port_t port);
+void i2c_bus_reset_stats(i2c_port_t port);
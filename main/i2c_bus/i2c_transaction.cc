@@ -0,0 +1,107 @@
+/* I2C master transactions with command links in caller provided buffers */
+#include "i2c_transaction.h"
+
+/* Address and prefix, the write phase of every transaction */
+static esp_err_t i2c_transaction_begin(
+    i2c_cmd_handle_t cmd,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length)
+{
+    auto err = i2c_master_start(cmd);
+    if (err == ESP_OK)
+    {
+        err = i2c_master_write_byte(
+            cmd, (address << 1) | I2C_MASTER_WRITE, true);
+    }
+    if (err == ESP_OK && prefix_length)
+    {
+        err = i2c_master_write(cmd, prefix, prefix_length, true);
+    }
+    return err;
+}
+
+/**
+ * @brief Write prefix (register address, command) and data in one
+ * transaction
+ *
+ * @param prefix up to I2C_TRANSACTION_MAX_PREFIX bytes
+ */
+esp_err_t i2c_transaction_write(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    const uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms)
+{
+    uint8_t link[I2C_TRANSACTION_LINK_SIZE];
+    auto cmd = i2c_cmd_link_create_static(link, sizeof(link));
+    auto err = i2c_transaction_begin(cmd, address, prefix, prefix_length);
+    if (err == ESP_OK && length)
+    {
+        err = i2c_master_write(cmd, data, length, true);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_stop(cmd);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_cmd_begin(port, cmd, pdMS_TO_TICKS(timeout_ms));
+    }
+    i2c_cmd_link_delete_static(cmd);
+    return err;
+}
+
+/**
+ * @brief Write prefix, then read data after repeated start. Without prefix
+ * only the read phase is sent.
+ *
+ * @param prefix up to I2C_TRANSACTION_MAX_PREFIX bytes
+ */
+esp_err_t i2c_transaction_read(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms)
+{
+    if (length == 0)
+    {
+        return ESP_OK;
+    }
+    uint8_t link[I2C_TRANSACTION_LINK_SIZE];
+    auto cmd = i2c_cmd_link_create_static(link, sizeof(link));
+    esp_err_t err = ESP_OK;
+    if (prefix_length)
+    {
+        err = i2c_transaction_begin(cmd, address, prefix, prefix_length);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_start(cmd);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_write_byte(
+            cmd, (address << 1) | I2C_MASTER_READ, true);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_read(cmd, data, length, I2C_MASTER_LAST_NACK);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_stop(cmd);
+    }
+    if (err == ESP_OK)
+    {
+        err = i2c_master_cmd_begin(port, cmd, pdMS_TO_TICKS(timeout_ms));
+    }
+    i2c_cmd_link_delete_static(cmd);
+    return err;
+}
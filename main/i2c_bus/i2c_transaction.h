@@ -0,0 +1,32 @@
+#pragma once
+
+#include <driver/i2c.h>
+
+#include <cstdint>
+
+/* Register address and command bytes written before data */
+#define I2C_TRANSACTION_MAX_PREFIX 2
+/**
+ * Command link of the longest transaction: write phase with prefix and data,
+ * repeated start, read phase. Built on the caller's stack, so transactions
+ * never touch the heap. Drivers go through i2c_bus.h, which schedules the
+ * transactions of all devices on a bus.
+ */
+#define I2C_TRANSACTION_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)
+
+esp_err_t i2c_transaction_write(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    const uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms);
+esp_err_t i2c_transaction_read(
+    i2c_port_t port,
+    uint8_t address,
+    const uint8_t* prefix,
+    uint32_t prefix_length,
+    uint8_t* data,
+    uint32_t length,
+    uint32_t timeout_ms);
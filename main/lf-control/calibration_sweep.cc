@@ -0,0 +1,62 @@
+/* Handshake of calibration sweeps between control task and NVS */
+#include "calibration_sweep.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "../cores.h"
+
+/* Waits for end of the sweep, then checks and saves it */
+static void calibration_sweep_task(void* pvParameters)
+{
+    auto sweep = (CalibrationSweep*)pvParameters;
+    while (sweep->state.load(std::memory_order_acquire)
+           == CALIBRATION_COLLECTING)
+    {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+
+    if (!sweep->check())
+    {
+        sweep->state.store(CALIBRATION_FAILED);
+        vTaskDelete(NULL);
+    }
+    sweep->ready.store(true, std::memory_order_release);
+
+    auto err = sweep->save();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(sweep->name, "Saving failed: %s", esp_err_to_name(err));
+    }
+    sweep->state.store(
+        err == ESP_OK ? CALIBRATION_DONE : CALIBRATION_FAILED);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Reset the sweep buffer and let the control task collect it
+ *
+ * @return false if previous sweep is not finished or not taken yet
+ */
+bool calibration_sweep_start(CalibrationSweep* sweep)
+{
+    uint8_t state = sweep->state.load();
+    if (state == CALIBRATION_COLLECTING || state == CALIBRATION_SAVING
+        || sweep->ready.load())
+    {
+        return false;
+    }
+    sweep->reset();
+    sweep->state.store(CALIBRATION_COLLECTING, std::memory_order_release);
+
+    xTaskCreatePinnedToCore(
+        &calibration_sweep_task,
+        sweep->name,
+        4096,
+        sweep,
+        2,
+        NULL,
+        CORE_SYSTEM);
+    return true;
+}
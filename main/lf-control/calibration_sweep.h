@@ -0,0 +1,57 @@
+#pragma once
+
+#include <esp_compiler.h>
+#include <esp_err.h>
+
+#include <atomic>
+#include <cstdint>
+
+enum CalibrationSweepState : uint8_t
+{
+    CALIBRATION_IDLE,
+    CALIBRATION_COLLECTING,  // control task collects the sweep
+    CALIBRATION_SAVING,      // calibration task checks and writes to NVS
+    CALIBRATION_DONE,
+    CALIBRATION_FAILED,      // previous calibration kept
+};
+
+/**
+ * @brief Sweep collected by the control task, then checked and saved by a
+ * task on CORE_SYSTEM, so NVS write never runs on the control core. Checked
+ * sweep is handed back to the control task, which applies it between cycles.
+ */
+struct CalibrationSweep
+{
+    const char* name;     // of the task and in the log
+    void (*reset)();      // empty sweep buffer before collecting
+    bool (*check)();      // false - sweep rejected, logs the reason
+    esp_err_t (*save)();  // checked sweep to NVS
+    std::atomic<uint8_t> state{CALIBRATION_IDLE};
+    std::atomic<bool> ready{false};  // checked sweep waiting for control task
+};
+
+bool calibration_sweep_start(CalibrationSweep* sweep);
+
+/* Control task, sweep buffer belongs to it while true */
+inline bool calibration_sweep_collecting(const CalibrationSweep& sweep)
+{
+    return unlikely(
+        sweep.state.load(std::memory_order_acquire) == CALIBRATION_COLLECTING);
+}
+
+/* Control task, last sample collected, buffer goes to calibration task */
+inline void calibration_sweep_collected(CalibrationSweep* sweep)
+{
+    sweep->state.store(CALIBRATION_SAVING, std::memory_order_release);
+}
+
+/* Control task, apply the sweep when true, then calibration_sweep_taken() */
+inline bool calibration_sweep_ready(const CalibrationSweep& sweep)
+{
+    return unlikely(sweep.ready.load(std::memory_order_acquire));
+}
+
+inline void calibration_sweep_taken(CalibrationSweep* sweep)
+{
+    sweep->ready.store(false, std::memory_order_release);
+}
@@ -3,10 +3,28 @@
 #include "../esc/esc.h"
 #include "../vl6180/vl6180.h"
 #include "../mpu6500/mpu6500.h"
+#include "../logging/trace_log.h"
+#include "../logging/binary_logging.h"
+#include "../logging/sd_logger.h"
+#include "../motors/motors.h"
+#include "control.h"
+#include "control_loop.h"
+#include "motion_estimator.h"
+#include "motor_calibration.h"
+#include "odometry.h"
+#include "relay_tuner.h"
+#include "sensors.h"
+#include "track_map.h"
+#include "triple_buffer.h"
+#include "wheel_speed.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+
 // ADC
 void ads7138_task(void* pvParameters) {
     ads7138_init();
@@ -24,7 +42,10 @@ void ads7138_task(void* pvParameters) {
 void as5055_test_task(void* pvParameters) {
     const char *TAG = "AS5055 task";
 
-    as5055_init();
+    trace_log_init();
+    if (!as5055_init()) {
+        vTaskDelete(NULL);
+    }
 
     float angle = 0;
 
@@ -43,8 +64,8 @@ void as5055_test_task(void* pvParameters) {
             angle = as5055_convert_angle(data);
         }
 
-        ESP_LOGI(TAG, "Angle hex %x", data);
-        ESP_LOGI(TAG, "Angle: %f", angle);
+        TRACE_LOGI(TAG, "Angle hex %x", data);
+        TRACE_LOGI(TAG, "Angle: %f", angle);
     }
     vTaskDelete(NULL);
 }
@@ -65,6 +86,7 @@ void esc_task(void* pvParameters) {
 // IMU
 void mpu6500_task(void* pvParameters)
 {
+    trace_log_init();
     mpu6500_init();
 
     mpu6500_data data;
@@ -76,18 +98,15 @@ void mpu6500_task(void* pvParameters)
 
         data = mpu6500_read_sensors();
 
-        ESP_LOGI(TAG, "Data form ACCEL XYZ: %u, %u, %u ", data.accel_x_be, data.accel_y_be, data.accel_z_be);
-        ESP_LOGI(TAG, "Data form TEMP: %u", data.temp_be);
-        ESP_LOGI(TAG, "Data form GYRO XYZ: %u, %u, %u ", data.gyro_x_be, data.gyro_y_be, data.gyro_z_be);
-
-        /* Recalculate raw data to more complex form */
-        mpu6500_calculate_results(TsACCEL, TsGYRO, data, 0);
+        TRACE_LOGI(TAG, "Data form ACCEL XYZ: %u, %u, %u ", data.accel_x_be, data.accel_y_be, data.accel_z_be);
+        TRACE_LOGI(TAG, "Data form TEMP: %u", data.temp_be);
+        TRACE_LOGI(TAG, "Data form GYRO XYZ: %u, %u, %u ", data.gyro_x_be, data.gyro_y_be, data.gyro_z_be);
 
-        ESP_LOGI(TAG, "SPEED XYZ: %f, %f, %f ", CalcDataMPU6500.speedX, CalcDataMPU6500.speedY, CalcDataMPU6500.speedZ);
-        ESP_LOGI(TAG, "POSITION XYZ: %f, %f, %f ", CalcDataMPU6500.positionX, CalcDataMPU6500.positionY, CalcDataMPU6500.positionZ);
+        TRACE_LOGI(TAG, "ACCEL XYZ [m/s^2]: %f, %f, %f ", mpu6500_accel_to_ms2(data.accel_x_be), mpu6500_accel_to_ms2(data.accel_y_be), mpu6500_accel_to_ms2(data.accel_z_be));
+        TRACE_LOGI(TAG, "GYRO XYZ [rad/s]: %f, %f, %f ", mpu6500_gyro_to_rads(data.gyro_x_be), mpu6500_gyro_to_rads(data.gyro_y_be), mpu6500_gyro_to_rads(data.gyro_z_be));
 
         temperature = mpu6500_temp_to_celsius(data.temp_be);
-        ESP_LOGI(TAG, "Temp %f", temperature);
+        TRACE_LOGI(TAG, "Temp %f", temperature);
     }
 
     vTaskDelete(NULL);
@@ -95,6 +114,7 @@ void mpu6500_task(void* pvParameters)
 
 // Distance sensor
 void vl6180_task(void* pvParameters) {
+    trace_log_init();
     vl6180_init();
     uint8_t data;
 
@@ -104,8 +124,295 @@ void vl6180_task(void* pvParameters) {
         vl6180_req_meas();
         vTaskDelay(pdMS_TO_TICKS(10));
         data = vl6180_take_distance();
-        ESP_LOGI(TAG, "Distance: %u", data );
+        TRACE_LOGI(TAG, "Distance: %u", data );
     }
 
     vTaskDelete(NULL);
 }
+
+// Line follower
+static LineFollowerSettings line_follower_settings;  // only control task
+static LineFollowerState line_follower_state;
+static MotorDuty motor_duty = {LF_DUTY_STOP, LF_DUTY_STOP};
+
+/* Line follower duties are wheel speed setpoints of the inner loop */
+#define CONTROL_WHEEL_SPEED_LOOP 1
+static WheelSpeedController wheel_speed;
+/* Raw duties of the motor sweep instead of line follower */
+static bool motor_sweep = false;
+static float motor_sweep_duty[MOTOR_COUNT];
+
+/* Requests from HTTP, taken by control task between cycles */
+static LineFollowerSettings settings_request;
+static std::atomic<bool> settings_requested{false};
+static TripleBuffer<LineFollowerSettings> settings_reports;  // applied, for HTTP task
+static RelayTunerSettings relay_request;
+static std::atomic<bool> relay_requested{false};
+static RelayTuner relay_tuner;                  // only control task
+static TripleBuffer<RelayTuner> relay_reports;  // copies for HTTP task
+
+/* Track map, learned on a slow lap, see track_map.h */
+#define TRACK_MAP_FILE SD_MOUNT "/track_map.bin"
+static constexpr char TAG_track_map[] = "Track map";
+static std::atomic<LineFollowerMode> mode{LF_MODE_FOLLOW};
+static LineFollowerMode mode_request;
+static std::atomic<bool> mode_requested{false};
+static Odometry odometry;
+static MotionEstimator motion;
+static TrackMapRecorder track_recorder;  // written by control in LF_MODE_LEARN
+static TrackMapFollower track_follower;
+static TrackMap race_map;                // used by control
+static TrackMap map_request;
+static std::atomic<bool> map_requested{false};
+static TrackMap track_map;               // built or loaded by HTTP task
+
+/* Relay experiment instead of steering PID, its gains replace the schedule */
+static void relay_tuner_control(float dt) {
+    float turn = relay_tuner_step(&relay_tuner, sensors_line(), dt);
+    motor_duty = line_follower_mix(relay_tuner.settings.base_duty, turn);
+    if (relay_tuner.state == RELAY_DONE) {
+        auto gains = relay_tuner_gains(relay_tuner);
+        if (!std::isfinite(gains.kp) || !std::isfinite(gains.ki) || !std::isfinite(gains.kd)) {
+            relay_tuner.state = RELAY_FAILED;  // live gains stay as they were
+        } else {
+            line_follower_set_gains(&line_follower_settings.steering, gains);
+            line_follower_state = LineFollowerState();
+            settings_reports.back_buffer() = line_follower_settings;
+            settings_reports.publish();
+        }
+    }
+    relay_reports.back_buffer() = relay_tuner;
+    relay_reports.publish();
+    LOG_VALUES_DELTA("relay_tuner", turn, relay_tuner.periods, relay_tuner.ku, relay_tuner.tu);
+}
+
+/* ControlStages::control */
+void line_follower_control_stage(float dt) {
+    if (unlikely(settings_requested.load(std::memory_order_acquire))) {
+        line_follower_settings = settings_request;
+        line_follower_state = LineFollowerState();
+        settings_reports.back_buffer() = line_follower_settings;
+        settings_reports.publish();
+        settings_requested.store(false, std::memory_order_release);
+    }
+    if (unlikely(relay_requested.load(std::memory_order_acquire))) {
+        relay_tuner_start(&relay_tuner, relay_request);
+        // RELAY_RUNNING is visible before the next request is allowed
+        relay_reports.back_buffer() = relay_tuner;
+        relay_reports.publish();
+        relay_requested.store(false, std::memory_order_release);
+    }
+#if SENSORS_USE_ENCODER
+    odometry_update_encoder(&odometry, sensors_frame().encoder, dt);
+#else
+    odometry_update_duty(&odometry, motor_duty, dt);
+#endif
+    auto& imu = sensors_frame().imu;
+    motion_estimate(&motion, SENSORS_IMU_YAW_SIGN * mpu6500_gyro_to_rads(imu.gyro_z_be),
+                    SENSORS_IMU_FORWARD_SIGN * mpu6500_accel_to_ms2(imu.accel_x_be), odometry.speed,
+                    motor_duty_curvature(motor_duty), dt);
+    auto& m = motion.estimate;
+    LOG_VALUES_DELTA("motion", m.heading, m.yaw_rate, m.velocity, m.curvature, m.yaw_slip, m.wheel_slip, m.sliding);
+
+    bool sweeping = motor_calibration_update(m.yaw_rate, sensors_frame().battery_v, dt, motor_sweep_duty);
+    if (unlikely(sweeping || motor_sweep)) {
+        motor_sweep = sweeping;
+        motor_duty = {LF_DUTY_STOP, LF_DUTY_STOP};
+        line_follower_state = LineFollowerState();
+        wheel_speed_reset(&wheel_speed);
+        LOG_VALUES_DELTA("motor_sweep", motor_sweep_duty);
+        return;
+    }
+
+    if (unlikely(relay_tuner.state == RELAY_RUNNING)) {
+        relay_tuner_control(dt);
+        return;
+    }
+
+    if (unlikely(map_requested.load(std::memory_order_acquire))) {
+        race_map = map_request;
+        map_requested.store(false, std::memory_order_release);
+    }
+    if (unlikely(mode_requested.load(std::memory_order_acquire))) {
+        odometry = Odometry();
+        track_follower = TrackMapFollower();
+        if (mode_request == LF_MODE_LEARN) {
+            track_map_record_start(&track_recorder);
+        }
+        mode.store(mode_request, std::memory_order_relaxed);
+        mode_requested.store(false, std::memory_order_release);
+    }
+
+    float base_duty = line_follower_settings.base_duty;
+    auto current = mode.load(std::memory_order_relaxed);
+    if (current == LF_MODE_RACE) {
+        // curvature of the previous cycle, as driven
+        float v = track_map_follow(race_map, &track_follower, odometry.distance, motor_duty_curvature(motor_duty), dt);
+        base_duty = motor_speed_duty(v);
+        LOG_VALUES_DELTA("track_map", odometry.distance, track_follower.offset, v);
+    }
+
+    motor_duty = line_follower_step(line_follower_settings, &line_follower_state, sensors_line(), base_duty, dt);
+    if (current == LF_MODE_LEARN) {
+        track_map_record(&track_recorder, odometry.distance, motor_duty_curvature(motor_duty));
+    }
+    auto& steering = line_follower_state.steering;
+    LOG_VALUES_DELTA("line_follower", motor_duty.left, motor_duty.right, steering.d, steering.i);
+}
+
+/**
+ * @brief Replace settings (gain schedule from autotune), applied in the next
+ * control cycle
+ *
+ * @return false if previous request was not taken yet
+ */
+bool line_follower_set_settings(const LineFollowerSettings& settings) {
+    if (settings_requested.load(std::memory_order_acquire)) {
+        return false;
+    }
+    settings_request = settings;
+    settings_requested.store(true, std::memory_order_release);
+    return true;
+}
+
+/* Settings last applied by control task, only HTTP task may call it */
+LineFollowerSettings line_follower_get_settings() {
+    settings_reports.update();
+    return settings_reports.front_buffer();
+}
+
+/* Start relay experiment on the robot, robot should stand on the line */
+bool line_follower_autotune(const RelayTunerSettings& settings) {
+    if (relay_requested.load(std::memory_order_acquire) || line_follower_tuner().state == RELAY_RUNNING ||
+        motor_calibration_state() == MOTOR_CAL_SWEEPING) {
+        return false;
+    }
+    relay_request = settings;
+    relay_requested.store(true, std::memory_order_release);
+    return true;
+}
+
+/* Last state published by control task, only HTTP task may call it */
+RelayTuner line_follower_tuner() {
+    relay_reports.update();
+    return relay_reports.front_buffer();
+}
+/**
+ * @brief Switch mode in the next control cycle, odometry starts from zero, so
+ * robot should stand at the lap start
+ *
+ * @return false if previous request was not taken yet, or race has no map
+ */
+bool line_follower_set_mode(LineFollowerMode new_mode) {
+    if (mode_requested.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (new_mode == LF_MODE_RACE && (!SENSORS_USE_ENCODER || !track_map.segments)) {
+        // duty odometry is only good enough for the slow learning lap
+        return false;
+    }
+    mode_request = new_mode;
+    mode_requested.store(true, std::memory_order_release);
+    return true;
+}
+
+LineFollowerMode line_follower_mode() {
+    return mode.load(std::memory_order_relaxed);
+}
+
+/* Hand the map over to control task, called from HTTP task */
+static bool line_follower_use_map() {
+    if (map_requested.load(std::memory_order_acquire)) {
+        return false;
+    }
+    map_request = track_map;
+    map_requested.store(true, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Build map from the finished learning lap and save it to SD card
+ *
+ * @return false while still learning or if the lap is too short
+ */
+bool line_follower_build_map(const SpeedProfileSettings& profile) {
+    if (line_follower_mode() == LF_MODE_LEARN || mode_requested.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (!track_map_build(track_recorder, profile, &track_map)) {
+        return false;
+    }
+    if (!track_map_save(track_map, TRACK_MAP_FILE)) {
+        ESP_LOGW(TAG_track_map, "Track map not saved to %s", TRACK_MAP_FILE);
+    }
+    ESP_LOGI(TAG_track_map, "%" PRIu32 " segments, %.2f m", track_map.segments, track_map.length);
+    return line_follower_use_map();
+}
+
+/* Map saved by line_follower_build_map() */
+bool line_follower_load_map() {
+    if (line_follower_mode() == LF_MODE_RACE || !track_map_load(&track_map, TRACK_MAP_FILE)) {
+        return false;
+    }
+    return line_follower_use_map();
+}
+
+/* Motor table sweep, robot pivots on one wheel, see motor_calibration.h */
+bool line_follower_calibrate_motors() {
+    if (relay_requested.load(std::memory_order_acquire) || line_follower_tuner().state == RELAY_RUNNING) {
+        return false;
+    }
+    return motor_calibration_start();
+}
+
+/* Heading, yaw rate and velocity from gyro and odometry, control task only */
+const MotionEstimate& line_follower_motion() {
+    return motion.estimate;
+}
+
+/* Last built or loaded map, HTTP task only */
+const TrackMap& line_follower_map() {
+    return track_map;
+}
+
+/* ControlStages::actuate */
+void motors_actuate_stage(float dt) {
+    if (unlikely(motor_sweep)) {
+        mcpwm_update_motors_raw(motor_sweep_duty[0], motor_sweep_duty[1]);
+        return;
+    }
+    motors_set_battery(sensors_frame().battery_v);
+#if CONTROL_WHEEL_SPEED_LOOP
+    float setpoint[WHEELS], measured[WHEELS];
+    motor_duty_wheel_speeds(motor_duty, setpoint);
+    auto& m = motion.estimate;
+#if SENSORS_USE_ENCODER
+    float forward = m.velocity;
+#else
+    // duty odometry would only feed the command back, forward runs on feedforward
+    float forward = 0.5f * (setpoint[WHEEL_LEFT] + setpoint[WHEEL_RIGHT]);
+#endif
+    wheel_speeds_from_motion(forward, m.yaw_rate, measured);
+    auto duty = wheel_speed_step(&wheel_speed, setpoint, measured, dt);
+    LOG_VALUES_DELTA("wheel_speed", setpoint, wheel_speed.reference, measured, duty.left, duty.right);
+    mcpwm_update_motors(duty.left, duty.right);
+#else
+    mcpwm_update_motors(motor_duty.left, motor_duty.right);
+#endif
+}
+
+bool line_follower_start() {
+    trace_log_init();  // TRACE_LOGx in the control loop only enqueue
+    wheel_speed_init(&wheel_speed);
+    sensors_start();
+    motors_lut_load();
+    mcpwm_init();
+    mcpwm_start_motor(LF_DUTY_STOP);
+    static constexpr ControlStages stages = {
+        .read_sensors = sensors_read_stage,
+        .estimate = sensors_estimate_stage,
+        .control = line_follower_control_stage,
+        .actuate = motors_actuate_stage,
+    };
+    return control_loop_start(stages);
+}
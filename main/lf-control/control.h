@@ -0,0 +1,27 @@
+#pragma once
+
+#include "line_follower.h"
+#include "motion_estimator.h"
+#include "relay_tuner.h"
+#include "track_map.h"
+
+enum LineFollowerMode {
+    LF_MODE_FOLLOW,  // constant base_duty
+    LF_MODE_LEARN,   // constant base_duty, track map recorded
+    LF_MODE_RACE,    // speed from track map
+};
+
+void line_follower_control_stage(float dt);
+void motors_actuate_stage(float dt);
+bool line_follower_start();
+bool line_follower_set_settings(const LineFollowerSettings& settings);
+LineFollowerSettings line_follower_get_settings();
+bool line_follower_autotune(const RelayTunerSettings& settings);
+RelayTuner line_follower_tuner();
+bool line_follower_set_mode(LineFollowerMode mode);
+LineFollowerMode line_follower_mode();
+bool line_follower_build_map(const SpeedProfileSettings& profile);
+bool line_follower_load_map();
+const TrackMap& line_follower_map();
+const MotionEstimate& line_follower_motion();
+bool line_follower_calibrate_motors();
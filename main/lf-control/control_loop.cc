@@ -0,0 +1,193 @@
+/* Fixed rate control executive woken by esp_timer */
+#include "control_loop.h"
+
+#include <esp_attr.h>
+#include <esp_compiler.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cinttypes>
+
+#include "../cores.h"
+#include "../logging/binary_logging.h"
+
+static const char TAG[] = "control_loop";
+
+TaskHandle_t control_loop_task_handle = NULL;
+
+static esp_timer_handle_t control_timer = NULL;
+static ControlStages control_stages;
+static uint32_t control_period_us;
+
+/* written only by control task */
+static ControlLoopStats control_stats;
+static uint64_t control_exec_sum_us;
+static volatile bool control_stats_reset;
+static volatile bool control_stop_requested;
+
+/* Only wakes the task, whole cycle runs in task context */
+static void IRAM_ATTR control_timer_callback(void* arg)
+{
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(control_loop_task_handle, &woken);
+    if (woken)
+    {
+        esp_timer_isr_dispatch_need_yield();
+    }
+#else
+    xTaskNotifyGive(control_loop_task_handle);
+#endif
+}
+
+static void control_loop_task(void* pvParameters)
+{
+    const float dt = control_period_us * 1e-6f;
+    int64_t first_us = 0;
+    uint32_t ticks = 0;  // timer ticks since first cycle, also missed
+
+    while (1)
+    {
+        auto pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start_us = esp_timer_get_time();
+        if (unlikely(control_stop_requested))
+        {
+            break;
+        }
+        if (unlikely(control_stats_reset))
+        {
+            control_stats = {.rate_hz = 1000000 / control_period_us};
+            control_exec_sum_us = 0;
+            control_stats_reset = false;
+        }
+        if (unlikely(!first_us))
+        {
+            first_us = start_us;
+            pending = 1;
+        }
+        ticks += pending;
+        control_stats.missed_ticks += pending - 1;
+
+        if (control_stages.read_sensors)
+        {
+            control_stages.read_sensors(dt);
+        }
+        if (control_stages.estimate)
+        {
+            control_stages.estimate(dt);
+        }
+        if (control_stages.control)
+        {
+            control_stages.control(dt);
+        }
+        if (control_stages.actuate)
+        {
+            control_stages.actuate(dt);
+        }
+
+        int64_t end_us = esp_timer_get_time();
+        // esp_timer keeps period without drift, so ideal start is known
+        int64_t scheduled_us =
+            first_us + int64_t(ticks - 1) * control_period_us;
+        uint32_t jitter_us =
+            start_us > scheduled_us ? start_us - scheduled_us : 0;
+        uint32_t exec_us = end_us - start_us;
+
+        auto& s = control_stats;
+        s.cycles++;
+        if (jitter_us + exec_us > control_period_us)
+        {
+            s.deadline_misses++;
+        }
+        if (jitter_us > s.jitter_max_us)
+        {
+            s.jitter_max_us = jitter_us;
+        }
+        if (exec_us > s.exec_max_us)
+        {
+            s.exec_max_us = exec_us;
+        }
+        control_exec_sum_us += exec_us;
+
+        LOG_VALUES_DELTA("control_timing", ticks, jitter_us, exec_us);
+    }
+    control_loop_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Start control task and periodic timer
+ *
+ * @param stages
+ * @param rate_hz CONTROL_LOOP_MIN_RATE_HZ - CONTROL_LOOP_MAX_RATE_HZ
+ * @return false if already running or rate out of range
+ */
+bool control_loop_start(const ControlStages& stages, uint32_t rate_hz)
+{
+    if (control_timer || rate_hz < CONTROL_LOOP_MIN_RATE_HZ
+        || rate_hz > CONTROL_LOOP_MAX_RATE_HZ)
+    {
+        ESP_LOGE(TAG, "Cannot start control loop at %" PRIu32 " Hz", rate_hz);
+        return false;
+    }
+    control_stages = stages;
+    control_period_us = 1000000 / rate_hz;
+    control_stats_reset = true;
+    control_stop_requested = false;
+
+    /* above all sensor and logger tasks */
+    xTaskCreatePinnedToCore(
+        &control_loop_task,
+        "control_loop",
+        4096,
+        NULL,
+        configMAX_PRIORITIES - 2,
+        &control_loop_task_handle,
+        CORE_CONTROL);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = &control_timer_callback,
+        .arg = NULL,
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = "control_loop",
+        .skip_unhandled_events = false,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &control_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(control_timer, control_period_us));
+
+    ESP_LOGI(TAG, "Control loop started at %" PRIu32 " Hz", rate_hz);
+    return true;
+}
+
+/* Task ends after current cycle, outputs stay as set by last actuate */
+void control_loop_stop()
+{
+    if (!control_timer)
+    {
+        return;
+    }
+    esp_timer_stop(control_timer);
+    esp_timer_delete(control_timer);
+    control_timer = NULL;
+    control_stop_requested = true;
+    xTaskNotifyGive(control_loop_task_handle);
+}
+
+ControlLoopStats control_loop_get_stats()
+{
+    auto stats = control_stats;
+    if (stats.cycles)
+    {
+        stats.exec_avg_us = control_exec_sum_us / stats.cycles;
+    }
+    return stats;
+}
+
+/* Done by control task before next cycle */
+void control_loop_reset_stats() { control_stats_reset = true; }
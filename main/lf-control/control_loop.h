@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+/* Rate of control cycle, limited by the sensors read in one cycle */
+#define CONTROL_LOOP_DEFAULT_RATE_HZ 1000
+#define CONTROL_LOOP_MIN_RATE_HZ 1000
+#define CONTROL_LOOP_MAX_RATE_HZ 4000
+
+/**
+ * @brief One deterministic control cycle, stages are called in this order
+ * from one task, NULL stages are skipped. dt - nominal period in seconds.
+ */
+struct ControlStages
+{
+    void (*read_sensors)(float dt);
+    void (*estimate)(float dt);
+    void (*control)(float dt);
+    void (*actuate)(float dt);
+};
+
+struct ControlLoopStats
+{
+    uint32_t rate_hz;
+    uint32_t cycles;
+    uint32_t missed_ticks;     // timer ticks lost while cycle was running
+    uint32_t deadline_misses;  // cycle ended after start of next period
+    uint32_t jitter_max_us;    // cycle start after its scheduled time
+    uint32_t exec_max_us;
+    uint32_t exec_avg_us;
+};
+
+bool control_loop_start(
+    const ControlStages& stages,
+    uint32_t rate_hz = CONTROL_LOOP_DEFAULT_RATE_HZ);
+void control_loop_stop();
+ControlLoopStats control_loop_get_stats();
+void control_loop_reset_stats();
@@ -0,0 +1,164 @@
+/* Line sensor calibration sweep, result kept in NVS */
+#include "line_calibration.h"
+
+#include <esp_compiler.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cinttypes>
+
+#include "../wifi/nvs_blob.h"
+#include "calibration_sweep.h"
+
+static const char TAG[] = "line_calibration";
+
+static const char line_calibration_nvs_namespace[] = "line_sensors";
+static const char line_calibration_nvs_key[] = "calibration";
+
+/* written by control task while SAMPLING, then by calibration task */
+static LineCalibrationData sweep;
+static int64_t sweep_end_us = 0;
+static uint32_t sweep_duration_ms;  // of the next sweep
+/* last valid calibration, for reporting */
+static LineCalibrationData current = {};
+
+static void apply(LineEstimator* estimator, const LineCalibrationData& data)
+{
+#if LINE_SENSOR_LINE_HIGH
+    line_estimator_calibrate(estimator, data.min, data.max);
+#else
+    line_estimator_calibrate(estimator, data.max, data.min);
+#endif
+}
+
+static bool check(const LineCalibrationData& data)
+{
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        if (data.max[k] < data.min[k] + LINE_CALIBRATION_MIN_SPAN)
+        {
+            ESP_LOGE(
+                TAG,
+                "Channel %" PRIu32 " span too small: %u..%u",
+                k,
+                data.min[k],
+                data.max[k]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void reset_sweep()
+{
+    sweep.version = LINE_CALIBRATION_VERSION;
+    sweep.samples = 0;
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        sweep.min[k] = UINT16_MAX;
+        sweep.max[k] = 0;
+    }
+    sweep_end_us = esp_timer_get_time() + sweep_duration_ms * 1000LL;
+}
+
+static bool check_sweep() { return check(sweep); }
+
+static esp_err_t save_sweep()
+{
+    ESP_LOGI(TAG, "Calibrated from %" PRIu32 " samples", sweep.samples);
+    return nvs_blob_save(
+        line_calibration_nvs_namespace,
+        line_calibration_nvs_key,
+        &sweep,
+        sizeof(sweep));
+}
+
+static CalibrationSweep calibration = {
+    .name = "line_calibration",
+    .reset = reset_sweep,
+    .check = check_sweep,
+    .save = save_sweep,
+};
+
+/**
+ * @brief Load calibration saved by last sweep, at boot before control loop
+ *
+ * @return false if there is none, estimator keeps defaults
+ */
+bool line_calibration_load(LineEstimator* estimator)
+{
+    LineCalibrationData data;
+    auto err = nvs_blob_load(
+        line_calibration_nvs_namespace,
+        line_calibration_nvs_key,
+        &data,
+        sizeof(data));
+    if (err != ESP_OK || data.version != LINE_CALIBRATION_VERSION
+        || !check(data))
+    {
+        ESP_LOGW(TAG, "No valid calibration in NVS (%s)", esp_err_to_name(err));
+        return false;
+    }
+    apply(estimator, data);
+    current = data;
+    ESP_LOGI(TAG, "Loaded calibration of %" PRIu32 " samples", data.samples);
+    return true;
+}
+
+/**
+ * @brief Start recording min/max of every channel, robot should be moved
+ * so every sensor passes over the line and over the background
+ *
+ * @param duration_ms
+ * @return false if sweep is already running
+ */
+bool line_calibration_start(uint32_t duration_ms)
+{
+    sweep_duration_ms = duration_ms;
+    if (!calibration_sweep_start(&calibration))
+    {
+        return false;
+    }
+    ESP_LOGI(TAG, "Calibration sweep for %" PRIu32 " ms", duration_ms);
+    return true;
+}
+
+/**
+ * @brief Called by control task for every sensor frame, collects the sweep
+ * and applies finished calibration between estimates
+ */
+void line_calibration_update(
+    LineEstimator* estimator,
+    const uint16_t raw[LINE_SENSORS],
+    int64_t timestamp_us)
+{
+    if (calibration_sweep_ready(calibration))
+    {
+        apply(estimator, sweep);
+        current = sweep;
+        calibration_sweep_taken(&calibration);
+    }
+    if (!calibration_sweep_collecting(calibration))
+    {
+        return;
+    }
+
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        sweep.min[k] = raw[k] < sweep.min[k] ? raw[k] : sweep.min[k];
+        sweep.max[k] = raw[k] > sweep.max[k] ? raw[k] : sweep.max[k];
+    }
+    sweep.samples++;
+    if (timestamp_us >= sweep_end_us)
+    {
+        calibration_sweep_collected(&calibration);
+    }
+}
+
+LineCalibrationState line_calibration_state()
+{
+    return (LineCalibrationState)calibration.state.load();
+}
+
+/* Calibration used by estimator, copied for HTTP - may be torn by update */
+LineCalibrationData line_calibration_data() { return current; }
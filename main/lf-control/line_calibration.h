@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "calibration_sweep.h"
+#include "line_estimator.h"
+
+/* Sensor output is higher over the line than over the background */
+#define LINE_SENSOR_LINE_HIGH 1
+
+#define LINE_CALIBRATION_DEFAULT_MS 3000
+#define LINE_CALIBRATION_MAX_MS 30000
+/* Smaller difference of min and max - channel has not seen the line */
+#define LINE_CALIBRATION_MIN_SPAN 2000
+
+#define LINE_CALIBRATION_VERSION 1
+
+enum LineCalibrationState : uint8_t
+{
+    LINE_CAL_IDLE = CALIBRATION_IDLE,
+    LINE_CAL_SAMPLING = CALIBRATION_COLLECTING,  // control task takes min/max
+    LINE_CAL_SAVING = CALIBRATION_SAVING,
+    LINE_CAL_DONE = CALIBRATION_DONE,
+    LINE_CAL_FAILED = CALIBRATION_FAILED,  // previous calibration kept
+};
+
+/* Result of one sweep, stored in NVS as a blob */
+struct LineCalibrationData
+{
+    uint32_t version;
+    uint32_t samples;
+    uint16_t min[LINE_SENSORS];
+    uint16_t max[LINE_SENSORS];
+};
+
+bool line_calibration_load(LineEstimator* estimator);
+bool line_calibration_start(uint32_t duration_ms);
+void line_calibration_update(
+    LineEstimator* estimator,
+    const uint16_t raw[LINE_SENSORS],
+    int64_t timestamp_us);
+LineCalibrationState line_calibration_state();
+LineCalibrationData line_calibration_data();
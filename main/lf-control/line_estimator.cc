@@ -0,0 +1,107 @@
+/* Line position from the reflective sensor array */
+#include "line_estimator.h"
+
+#include <cmath>
+
+/* Calibration for raw full scale, before real one is done */
+void line_estimator_init(LineEstimator* estimator)
+{
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        estimator->calibration.offset[k] = 0;
+        estimator->calibration.recip[k] = 1.f / UINT16_MAX;
+    }
+    estimator->last_position = 0;
+}
+
+/**
+ * @brief Compute calibration from readings over background and over line
+ *
+ * @param background
+ * @param line
+ * @param gain extra sensitivity correction of every channel, NULL - 1
+ */
+void line_estimator_calibrate(
+    LineEstimator* estimator,
+    const uint16_t background[LINE_SENSORS],
+    const uint16_t line[LINE_SENSORS],
+    const float gain[LINE_SENSORS])
+{
+    auto& cal = estimator->calibration;
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        float span = float(line[k]) - float(background[k]);
+        if (fabsf(span) < 1)
+        {  // dead channel, never reports the line
+            span = UINT16_MAX;
+        }
+        cal.offset[k] = background[k];
+        cal.recip[k] = (gain ? gain[k] : 1.f) / span;
+    }
+}
+
+/**
+ * @brief Estimate line position, fixed number of operations for every sample.
+ * Background (lowest channel) is removed before centroid, so wide line and
+ * ambient light do not pull position to the middle.
+ * When the line is lost, position stays at the edge where it was last seen.
+ */
+void line_estimate(
+    LineEstimator* estimator,
+    const uint16_t raw[LINE_SENSORS],
+    LineEstimate* out)
+{
+    auto& cal = estimator->calibration;
+    float peak_value = 0, floor_value = 1;
+    uint32_t peak = 0;
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        float v = (float(raw[k]) - cal.offset[k]) * cal.recip[k];
+        v = fminf(fmaxf(v, 0.f), 1.f);
+        out->normalized[k] = v;
+        floor_value = fminf(floor_value, v);
+        bool higher = v > peak_value;
+        peak = higher ? k : peak;
+        peak_value = higher ? v : peak_value;
+    }
+
+    // centroid of channels around the peak, far ones add only noise
+    float weight = 0, moment = 0;
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        int32_t distance = int32_t(k) - int32_t(peak);
+        float in_window = distance >= -LINE_CENTROID_WINDOW
+                          && distance <= LINE_CENTROID_WINDOW;
+        float v = (out->normalized[k] - floor_value) * in_window;
+        weight += v;
+        moment += v * (float(k) - LINE_POSITION_MAX);
+    }
+    float centroid = moment / fmaxf(weight, 1e-6f);
+
+    // parabola fitted on 3 channels around the peak, kept inside the array
+    uint32_t c = peak < 1 ? 1 : peak;
+    c = c > LINE_SENSORS - 2 ? LINE_SENSORS - 2 : c;
+    float l = out->normalized[c - 1], m = out->normalized[c],
+          r = out->normalized[c + 1];
+    float curvature = l - 2 * m + r;
+    float shift = 0.5f * (l - r) / (curvature < -1e-6f ? curvature : -1e-6f);
+    shift = fminf(fmaxf(shift, -1.f), 1.f);
+    float parabolic = float(c) + shift - LINE_POSITION_MAX;
+
+    float position = estimator->mode == LINE_PARABOLIC ? parabolic : centroid;
+    position = fminf(fmaxf(position, -LINE_POSITION_MAX), LINE_POSITION_MAX);
+
+    out->confidence = peak_value - floor_value;
+    out->line_lost = out->confidence < estimator->lost_threshold;
+    out->peak = peak;
+    if (out->line_lost)
+    {
+        // centered line lost (gap, start) gives no side to turn to
+        float last = estimator->last_position;
+        position = fabsf(last) < LINE_LOST_SIDE_MIN
+                       ? 0
+                       : copysignf(LINE_POSITION_MAX, last);
+    }
+    estimator->last_position = position;
+    out->position = position;
+}
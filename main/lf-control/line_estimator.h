@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#define LINE_SENSORS 8
+
+/* Position in sensor pitches from the middle of the array */
+#define LINE_POSITION_MAX (0.5f * (LINE_SENSORS - 1))
+
+/* Channels on each side of the peak used by LINE_CENTROID */
+#define LINE_CENTROID_WINDOW 2
+
+/* Lost line is put on the side of last position only if it was this far off */
+#define LINE_LOST_SIDE_MIN 0.5f
+
+enum LineEstimatorMode : uint8_t
+{
+    LINE_CENTROID,   // weighted centroid, smooth, line may cover many sensors
+    LINE_PARABOLIC,  // parabola through the peak and its neighbours
+};
+
+/**
+ * @brief Per channel calibration, normalized value is
+ * (raw - offset) * recip, 0 - background, 1 - line.
+ * recip folds channel gain and 1 / (line - background), precomputed once,
+ * so no division is done per sample. Works for both line polarities.
+ */
+struct LineCalibration
+{
+    float offset[LINE_SENSORS];
+    float recip[LINE_SENSORS];
+};
+
+struct LineEstimate
+{
+    float position;    // -LINE_POSITION_MAX..LINE_POSITION_MAX
+    float confidence;  // peak - background of normalized values, 0..1
+    bool line_lost;
+    uint8_t peak;      // channel with the strongest response
+    float normalized[LINE_SENSORS];
+};
+
+struct LineEstimator
+{
+    LineCalibration calibration;
+    LineEstimatorMode mode = LINE_CENTROID;
+    float lost_threshold = 0.25f;  // confidence below - no line
+    float last_position = 0;
+};
+
+void line_estimator_init(LineEstimator* estimator);
+void line_estimator_calibrate(
+    LineEstimator* estimator,
+    const uint16_t background[LINE_SENSORS],
+    const uint16_t line[LINE_SENSORS],
+    const float gain[LINE_SENSORS] = nullptr);
+void line_estimate(
+    LineEstimator* estimator,
+    const uint16_t raw[LINE_SENSORS],
+    LineEstimate* out);
@@ -0,0 +1,85 @@
+#include "line_follower.h"
+
+#include <cmath>
+#include <cstddef>
+
+static float duty_saturation(float duty) {
+    return duty < LF_DUTY_MIN ? LF_DUTY_MIN : (duty > LF_DUTY_MAX ? LF_DUTY_MAX : duty);
+}
+
+/* Motor duties for forward drive and turn, positive turn - to the left */
+MotorDuty line_follower_mix(float base_duty, float turn) {
+    return {
+        .left = duty_saturation(LF_DUTY_STOP + base_duty - 0.5f * turn),
+        .right = duty_saturation(LF_DUTY_STOP + base_duty + 0.5f * turn),
+    };
+}
+
+/* Same gains at every schedule point, e.g. from the relay experiment */
+void line_follower_set_gains(SteeringSettings* steering, const LineFollowerGains& gains) {
+    for (uint32_t k = 0; k < LF_SCHEDULE_POINTS; k++) {
+        line_follower_set_schedule(steering, k, gains);
+    }
+}
+
+/* Gains at schedule point k, points must stay ascending in base_duty */
+void line_follower_set_schedule(SteeringSettings* steering, uint32_t k, const LineFollowerGains& gains) {
+    steering->sched_speed[k] = gains.base_duty;
+    steering->kp[k][0] = gains.kp;
+    steering->ki[k][0] = gains.ki;
+    steering->kd[k][0] = gains.kd;
+}
+
+LineFollowerGains line_follower_gains(const SteeringSettings& steering, uint32_t k) {
+    return {steering.sched_speed[k], steering.kp[k][0], steering.ki[k][0], steering.kd[k][0]};
+}
+
+static bool all_finite(const float* values, uint32_t count) {
+    for (uint32_t k = 0; k < count; k++) {
+        if (!std::isfinite(values[k])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Settings from POST /line_follower may go to the live steering loop
+ *
+ * @return false for non-finite values, negative filter or anti-windup
+ * constants, empty turn range or schedule not ascending in base_duty
+ */
+bool line_follower_settings_valid(const LineFollowerSettings& settings) {
+    auto& s = settings.steering;
+    const uint32_t n = LF_SCHEDULE_POINTS;
+    if (!all_finite(s.sched_speed, n) || !all_finite(&s.kp[0][0], n) || !all_finite(&s.ki[0][0], n) ||
+        !all_finite(&s.kd[0][0], n) || !all_finite(&s.kff[0][0], n) || !all_finite(s.kaw, 1) ||
+        !all_finite(s.tf, 1) || !all_finite(s.out_min, 1) || !all_finite(s.out_max, 1) ||
+        !std::isfinite(settings.base_duty) || !std::isfinite(settings.lost_base_scale)) {
+        return false;
+    }
+    if (s.kaw[0] < 0 || s.tf[0] < 0 || s.out_min[0] >= s.out_max[0]) {
+        return false;
+    }
+    for (uint32_t k = 1; k < n; k++) {
+        if (s.sched_speed[k] < s.sched_speed[k - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MotorDuty line_follower_step(const LineFollowerSettings& settings, LineFollowerState* state,
+                             const LineEstimate& line, float dt) {
+    return line_follower_step(settings, state, line, settings.base_duty, dt);
+}
+
+/* Step with forward speed from speed profile instead of settings.base_duty */
+MotorDuty line_follower_step(const LineFollowerSettings& settings, LineFollowerState* state,
+                             const LineEstimate& line, float base_duty, float dt) {
+    // line on the left (positive position) - right wheel faster
+    const float setpoint = 0, meas = -line.position;
+    float turn = pid_bank_step(settings.steering, &state->steering, &setpoint, &meas, NULL, base_duty, dt)[0];
+    float base = base_duty * (line.line_lost ? settings.lost_base_scale : 1.f);
+    return line_follower_mix(base, turn);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+
+#include "line_estimator.h"
+#include "pid.h"
+
+/* Same limits as mcpwm_saturation, 0.5 - motor stopped */
+#define LF_DUTY_MIN 0.01f
+#define LF_DUTY_MAX 0.99f
+#define LF_DUTY_STOP 0.5f
+
+/* Robot model for odometry without encoder and for the simulator */
+#define LF_WHEEL_BASE_M 0.12f
+#define LF_WHEEL_SPEED_MAX 3.0f  // wheel speed at full duty [m/s]
+
+#define LF_SCHEDULE_POINTS 4
+/* Turn is duty difference of the wheels, this much drives one wheel full
+ * forward and the other full backward */
+#define LF_TURN_MAX (2 * (LF_DUTY_MAX - LF_DUTY_STOP))
+
+/* Steering gains for one forward speed */
+struct LineFollowerGains {
+    float base_duty, kp, ki, kd;
+};
+
+/**
+ * @brief Steering is one channel of the PID bank: line position [pitch] ->
+ * turn, gains interpolated by base_duty in sched_speed, ascending
+ */
+using SteeringSettings = PID_bank_settings_t<1, LF_SCHEDULE_POINTS>;
+
+/* Steering without gains: turn limit, anti-windup and derivative filter */
+inline SteeringSettings line_follower_steering_defaults() {
+    SteeringSettings steering;
+    steering.kaw[0] = 20;      // integral follows saturation in 50 ms
+    steering.tf[0] = 0.004f;   // [s]
+    steering.out_min[0] = -LF_TURN_MAX;
+    steering.out_max[0] = LF_TURN_MAX;
+    return steering;
+}
+
+/**
+ * @brief Sent as raw bytes by autotune and /line_follower, so only 32 bit
+ * fields - same layout on the robot and on the host.
+ */
+struct LineFollowerSettings {
+    SteeringSettings steering = line_follower_steering_defaults();
+    float base_duty = 0.15f;     // forward drive, added to LF_DUTY_STOP
+    float lost_base_scale = .5;  // forward drive when line is lost
+};
+
+struct LineFollowerState {
+    PID_bank_state_t<1> steering;
+};
+
+struct MotorDuty {
+    float left, right;
+};
+
+/**
+ * @brief One control step from line estimate to motor duties, no hardware
+ * access - the same code runs on the robot and in the host simulator
+ */
+MotorDuty line_follower_step(const LineFollowerSettings& settings, LineFollowerState* state,
+                             const LineEstimate& line, float dt);
+MotorDuty line_follower_step(const LineFollowerSettings& settings, LineFollowerState* state,
+                             const LineEstimate& line, float base_duty, float dt);
+MotorDuty line_follower_mix(float base_duty, float turn);
+bool line_follower_settings_valid(const LineFollowerSettings& settings);
+void line_follower_set_gains(SteeringSettings* steering, const LineFollowerGains& gains);
+void line_follower_set_schedule(SteeringSettings* steering, uint32_t k, const LineFollowerGains& gains);
+LineFollowerGains line_follower_gains(const SteeringSettings& steering, uint32_t k);
+
+/* Forward speed expected from duties [m/s], 0.5 - stop, 0.99 - full forward */
+inline float motor_duty_speed(const MotorDuty& duty) {
+    return (duty.left + duty.right - 2 * LF_DUTY_STOP) * LF_WHEEL_SPEED_MAX;
+}
+
+/* Path curvature expected from duties [1/m], positive - left turn */
+inline float motor_duty_curvature(const MotorDuty& duty) {
+    float forward = duty.left + duty.right - 2 * LF_DUTY_STOP;
+    if (forward < 0.01f) {
+        return 0;
+    }
+    return 2 * (duty.right - duty.left) / (LF_WHEEL_BASE_M * forward);
+}
+
+/* Base duty driving at speed [m/s] */
+inline float motor_speed_duty(float speed) {
+    return 0.5f * speed / LF_WHEEL_SPEED_MAX;
+}
@@ -0,0 +1,75 @@
+/* Heading and velocity from gyro, accelerometer and odometry */
+#include "motion_estimator.h"
+
+#include <cmath>
+
+void motion_estimator_init(MotionEstimator* estimator)
+{
+    estimator->estimate = MotionEstimate();
+    estimator->gyro_bias = 0;
+    estimator->accel_bias = 0;
+    estimator->slow_velocity = 0;
+    estimator->slip_time = 0;
+}
+
+/**
+ * @brief Update at control rate
+ *
+ * @param gyro_z yaw rate [rad/s], positive - left
+ * @param accel_x forward acceleration [m/s^2]
+ * @param odometry_speed from encoder, or from motor duties without it [m/s]
+ * @param commanded_curvature from motor duties [1/m], for slip detection
+ */
+void motion_estimate(
+    MotionEstimator* estimator,
+    float gyro_z,
+    float accel_x,
+    float odometry_speed,
+    float commanded_curvature,
+    float dt)
+{
+    auto& s = estimator->settings;
+    auto& e = estimator->estimate;
+
+    // robot may turn in place with zero odometry speed, gyro must agree
+    bool still = fabsf(odometry_speed) < s.still_speed
+                 && fabsf(gyro_z - estimator->gyro_bias) < s.still_yaw_rate;
+    if (still)
+    {
+        // standing robot does not turn nor accelerate, what is left is bias
+        float k = dt / (s.bias_tc + dt);
+        estimator->gyro_bias += (gyro_z - estimator->gyro_bias) * k;
+        estimator->accel_bias += (accel_x - estimator->accel_bias) * k;
+    }
+
+    e.yaw_rate = still ? 0 : gyro_z - estimator->gyro_bias;
+    e.heading += e.yaw_rate * dt;
+
+    // odometry is wrong while wheels slip, accelerometer alone carries on
+    float accel = accel_x - estimator->accel_bias;
+    auto& slow = estimator->slow_velocity;
+    slow += accel * dt;
+    if (!e.sliding)
+    {
+        slow += (odometry_speed - slow) * dt / (s.slip_tc + dt);
+    }
+    float k = dt / (s.velocity_tc + dt);
+    e.velocity += accel * dt;
+    e.velocity += ((e.sliding ? slow : odometry_speed) - e.velocity) * k;
+
+    e.curvature =
+        fabsf(e.velocity) > s.min_speed ? e.yaw_rate / e.velocity : 0;
+
+    // tyres slide sideways - robot turns other way than wheels command,
+    // wheels spin or lock - odometry runs away from accelerometer
+    e.yaw_slip += (e.yaw_rate - commanded_curvature * e.velocity - e.yaw_slip)
+                  * k;
+    e.wheel_slip = odometry_speed - slow;
+    e.sliding = fabsf(e.yaw_slip) > s.slip_yaw_rate
+                || fabsf(e.wheel_slip) > s.slip_speed;
+    estimator->slip_time = e.sliding ? estimator->slip_time + dt : 0;
+    if (estimator->slip_time > s.slip_max_s)
+    {
+        slow = odometry_speed;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Complementary filter fusing gyro Z and accelerometer X with
+ * odometry speed. Gyro gives yaw rate and heading, its bias is learned
+ * while the robot stands. Forward velocity is integrated from the
+ * accelerometer and pulled to odometry speed, so encoder quantization and
+ * accelerometer drift cancel out.
+ */
+struct MotionEstimatorSettings
+{
+    float velocity_tc = 0.02f;    // odometry correction time constant [s]
+    float bias_tc = 0.5f;         // gyro and accel bias learning [s]
+    float still_speed = 0.01f;    // odometry speed counted as standing [m/s]
+    float still_yaw_rate = 0.2f;  // gyro rate counted as standing [rad/s]
+    float slip_yaw_rate = 1.f;    // measured - commanded yaw rate [rad/s]
+    float slip_speed = 0.3f;      // odometry - slow velocity [m/s]
+    float slip_tc = 0.2f;         // slow velocity, follows odometry [s]
+    float slip_max_s = 0.5f;      // longer - accelerometer drifted, resync
+    float min_speed = 0.1f;       // below - curvature not computed [m/s]
+};
+
+struct MotionEstimate
+{
+    float heading;     // [rad] since init, positive - left
+    float yaw_rate;    // gyro without bias [rad/s]
+    float velocity;    // forward [m/s]
+    float curvature;   // yaw_rate / velocity [1/m]
+    float yaw_slip;    // yaw rate not explained by commanded curvature [rad/s]
+    float wheel_slip;  // odometry - slow velocity, wheels spin or lock [m/s]
+    bool sliding;
+};
+
+struct MotionEstimator
+{
+    MotionEstimatorSettings settings;
+    MotionEstimate estimate;
+    float gyro_bias = 0;      // [rad/s]
+    float accel_bias = 0;     // [m/s^2], includes tilt of the board
+    float slow_velocity = 0;  // as velocity, trusts accelerometer longer
+    float slip_time = 0;      // [s]
+};
+
+void motion_estimator_init(MotionEstimator* estimator);
+void motion_estimate(
+    MotionEstimator* estimator,
+    float gyro_z,
+    float accel_x,
+    float odometry_speed,
+    float commanded_curvature,
+    float dt);
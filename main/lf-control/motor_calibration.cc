@@ -0,0 +1,137 @@
+/**
+ * Motor duty sweep, result kept in NVS. There are no encoders on the wheels,
+ * so one motor is driven at a time and the robot pivots around the stopped
+ * wheel: wheel speed is gyro yaw rate * wheel base.
+ */
+#include "motor_calibration.h"
+
+#include <esp_compiler.h>
+#include <esp_log.h>
+
+#include <cinttypes>
+
+#include "../motors/motors.h"
+#include "calibration_sweep.h"
+#include "line_follower.h"
+
+static const char TAG[] = "motor_calibration";
+
+/* written by control task while SWEEPING, then by calibration task */
+static MotorLut sweep;
+static uint32_t sweep_motor, sweep_point;
+static float point_time, rate_sum;
+static uint32_t rate_samples;
+
+static void reset_sweep()
+{
+    sweep = MotorLut();
+    sweep_motor = 0;
+    sweep_point = 0;
+    point_time = 0;
+    rate_sum = 0;
+    rate_samples = 0;
+}
+
+static bool check_sweep()
+{
+    if (!motor_lut_prepare(&sweep))
+    {
+        ESP_LOGE(TAG, "A motor did not reach %.2f m/s", MOTOR_LUT_MIN_SPEED);
+        return false;
+    }
+    return true;
+}
+
+static esp_err_t save_sweep()
+{
+    ESP_LOGI(TAG, "Motor table swept at %.2f V", sweep.battery_v);
+    return motors_lut_save(sweep);
+}
+
+static CalibrationSweep calibration = {
+    .name = "motor_calibration",
+    .reset = reset_sweep,
+    .check = check_sweep,
+    .save = save_sweep,
+};
+
+/**
+ * @brief Start the sweep, robot should stand on a flat surface with room to
+ * spin, it turns at full speed
+ *
+ * @return false if sweep is already running
+ */
+bool motor_calibration_start()
+{
+    if (!calibration_sweep_start(&calibration))
+    {
+        return false;
+    }
+    ESP_LOGI(TAG, "Motor sweep, %d points", MOTOR_LUT_POINTS);
+    return true;
+}
+
+/**
+ * @brief Called by control task every cycle, runs the sweep and applies
+ * finished table between cycles
+ *
+ * @param yaw_rate gyro without bias [rad/s], positive - left
+ * @param duty raw duties of the sweep, for mcpwm_update_motors_raw()
+ * @return true while sweeping, motors must get duty
+ */
+bool motor_calibration_update(
+    float yaw_rate,
+    float battery_v,
+    float dt,
+    float duty[MOTOR_COUNT])
+{
+    if (calibration_sweep_ready(calibration))
+    {
+        motors_set_lut(sweep);
+        calibration_sweep_taken(&calibration);
+    }
+    if (!calibration_sweep_collecting(calibration))
+    {
+        return false;
+    }
+
+    point_time += dt;
+    if (point_time > MOTOR_CALIBRATION_SETTLE_S)
+    {
+        rate_sum += yaw_rate;
+        rate_samples++;
+    }
+    if (point_time >= MOTOR_CALIBRATION_SETTLE_S + MOTOR_CALIBRATION_MEASURE_S)
+    {
+        // left wheel alone turns the robot right
+        float rate = rate_sum / rate_samples;
+        sweep.speed[sweep_motor][sweep_point] =
+            (sweep_motor == 0 ? -rate : rate) * LF_WHEEL_BASE_M;
+        point_time = 0;
+        rate_sum = 0;
+        rate_samples = 0;
+        if (++sweep_point == MOTOR_LUT_POINTS)
+        {
+            sweep_point = 0;
+            sweep_motor++;
+        }
+        if (sweep_motor == MOTOR_COUNT)
+        {
+            sweep.battery_v = battery_v;
+            calibration_sweep_collected(&calibration);
+            return false;
+        }
+    }
+
+    for (uint32_t m = 0; m < MOTOR_COUNT; m++)
+    {
+        duty[m] = m == sweep_motor ? motor_lut_point_duty(sweep_point)
+                                   : MOTOR_DUTY_STOP;
+    }
+    return true;
+}
+
+MotorCalibrationState motor_calibration_state()
+{
+    return (MotorCalibrationState)calibration.state.load();
+}
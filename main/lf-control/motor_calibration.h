@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../motors/motor_lut.h"
+#include "calibration_sweep.h"
+
+/* Every sweep point: wait for the speed to settle, then average gyro */
+#define MOTOR_CALIBRATION_SETTLE_S 0.3f
+#define MOTOR_CALIBRATION_MEASURE_S 0.2f
+
+enum MotorCalibrationState : uint8_t
+{
+    MOTOR_CAL_IDLE = CALIBRATION_IDLE,
+    // control task drives one motor, other stopped
+    MOTOR_CAL_SWEEPING = CALIBRATION_COLLECTING,
+    MOTOR_CAL_SAVING = CALIBRATION_SAVING,
+    MOTOR_CAL_DONE = CALIBRATION_DONE,
+    MOTOR_CAL_FAILED = CALIBRATION_FAILED,  // previous table kept
+};
+
+bool motor_calibration_start();
+bool motor_calibration_update(
+    float yaw_rate,
+    float battery_v,
+    float dt,
+    float duty[MOTOR_COUNT]);
+MotorCalibrationState motor_calibration_state();
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include "line_follower.h"
+
+/* as5055 on the wheel shaft, 12 bit angle */
+#define ODOMETRY_ENCODER_COUNTS 4096
+#define ODOMETRY_WHEEL_RADIUS_M 0.0125f
+
+/* Travelled distance along the path */
+struct Odometry
+{
+    float distance = 0;  // [m]
+    float speed = 0;     // [m/s]
+    int32_t last_count = -1;
+};
+
+/**
+ * @brief Distance from as5055 angle, called every control cycle, so angle
+ * changes by less than half turn between calls
+ *
+ * @param raw as5055_read_angle_data() result
+ */
+inline void odometry_update_encoder(Odometry* odometry, uint16_t raw, float dt)
+{
+    int32_t count = (raw >> 2) & (ODOMETRY_ENCODER_COUNTS - 1);
+    if (odometry->last_count < 0)
+    {
+        odometry->last_count = count;
+    }
+    int32_t delta = count - odometry->last_count;
+    delta -= delta > ODOMETRY_ENCODER_COUNTS / 2 ? ODOMETRY_ENCODER_COUNTS : 0;
+    delta += delta < -ODOMETRY_ENCODER_COUNTS / 2 ? ODOMETRY_ENCODER_COUNTS : 0;
+    odometry->last_count = count;
+    float step = delta * (2 * 3.141592f * ODOMETRY_WHEEL_RADIUS_M
+                          / ODOMETRY_ENCODER_COUNTS);
+    odometry->distance += step;
+    odometry->speed = step / dt;
+}
+
+/* Without encoder - distance from speed expected from motor duties */
+inline void odometry_update_duty(
+    Odometry* odometry, const MotorDuty& duty, float dt)
+{
+    odometry->speed = motor_duty_speed(duty);
+    odometry->distance += odometry->speed * dt;
+}
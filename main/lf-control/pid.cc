@@ -2,8 +2,8 @@
 
 float pid_step(const PID_settings_t& settings, PID_state_t* state, float err, float dt) {
     state->i += clamp(err * dt, settings.ilimit);
-    state->di += (err - state->prev) / dt;
-    state->di -= state->di * settings.ad * dt;
+    /* derivative low-pass filtered like in pid_bank_step, tf = 1 / ad */
+    state->di += ((err - state->prev) / dt - state->di) * settings.ad * dt / (1 + settings.ad * dt);
     state->di = clamp(state->di, settings.dlimit);
     state->prev = err;
     return settings.kp * err + settings.ki * state->i + settings.kd * state->di;
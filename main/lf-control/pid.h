@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 template<class Tnum>
 Tnum clamp(Tnum val, Tnum limit) {
     if (val > limit) {
@@ -11,6 +13,7 @@ Tnum clamp(Tnum val, Tnum limit) {
     }
 }
 
+/* ad - derivative filter cutoff [1/s], independent of control rate */
 struct PID_settings_t {
     float kp = 0, ki = 0, kd = 0, ad = .1, ilimit = 1., dlimit = 1.;
 };
@@ -20,3 +23,101 @@ struct PID_state_t {
 };
 
 float pid_step(const PID_settings_t& settings, PID_state_t* state, float err, float dt);
+
+/* Gain schedule segment k..k1 and position t in it */
+struct PID_schedule_pos_t {
+    uint32_t k, k1;
+    float t;
+
+    float lerp(float a, float b) const { return a + (b - a) * t; }
+};
+
+/**
+ * @brief Find schedule variable x in n points given by point(k), ascending.
+ * Outside of the table the edge point is used.
+ */
+template<class Tpoint>
+PID_schedule_pos_t pid_schedule_pos(uint32_t n, Tpoint point, float x) {
+    uint32_t k = 0;
+    while (k + 2 < n && x > point(k + 1)) {
+        k++;
+    }
+    uint32_t k1 = n > 1 ? k + 1 : k;
+    float span = point(k1) - point(k);
+    float t = span > 0 ? (x - point(k)) / span : 0;
+    return {k, k1, t < 0 ? 0 : (t > 1 ? 1 : t)};
+}
+
+/**
+ * @brief Settings of N controllers, every parameter is an array over channels
+ * so one step is a few tight loops. Gains are given at Nsched speeds and
+ * interpolated linearly, outside of the table the edge gains are used.
+ */
+template<uint32_t N, uint32_t Nsched = 1>
+struct PID_bank_settings_t {
+    float sched_speed[Nsched] = {};  // ascending
+    float kp[Nsched][N] = {}, ki[Nsched][N] = {}, kd[Nsched][N] = {};
+    float kff[Nsched][N] = {};       // feedforward gain
+    float kaw[N] = {};               // back-calculation gain, ~ki/kp
+    float tf[N] = {};                // derivative filter time constant [s]
+    float out_min[N] = {}, out_max[N] = {};
+};
+
+template<uint32_t N>
+struct PID_bank_state_t {
+    float i[N] = {};          // integral term, already multiplied by ki
+    float d[N] = {};          // filtered derivative of measurement
+    float prev_meas[N] = {};
+    float out[N] = {};
+    bool first = true;
+};
+
+/**
+ * @brief Step all controllers of the bank.
+ * Derivative is taken from measurement, so setpoint steps do not kick the
+ * output. When output saturates, integral is pulled back by
+ * kaw * (out - unsaturated out), so it does not wind up.
+ *
+ * @param setpoint
+ * @param meas
+ * @param ff feedforward input of every channel, NULL - none
+ * @param speed schedule variable
+ * @param dt
+ * @return state.out
+ */
+template<uint32_t N, uint32_t Nsched>
+const float* pid_bank_step(const PID_bank_settings_t<N, Nsched>& settings, PID_bank_state_t<N>* state,
+                           const float* setpoint, const float* meas, const float* ff, float speed, float dt) {
+    const auto s = pid_schedule_pos(Nsched, [&](uint32_t k) { return settings.sched_speed[k]; }, speed);
+    const uint32_t k = s.k, k1 = s.k1;
+
+    if (state->first) {
+        for (uint32_t c = 0; c < N; c++) {
+            state->prev_meas[c] = meas[c];
+        }
+        state->first = false;
+    }
+
+    for (uint32_t c = 0; c < N; c++) {
+        float kp = s.lerp(settings.kp[k][c], settings.kp[k1][c]);
+        float ki = s.lerp(settings.ki[k][c], settings.ki[k1][c]);
+        float kd = s.lerp(settings.kd[k][c], settings.kd[k1][c]);
+        float kff = s.lerp(settings.kff[k][c], settings.kff[k1][c]);
+
+        float err = setpoint[c] - meas[c];
+        float d_raw = -(meas[c] - state->prev_meas[c]) / dt;
+        state->d[c] += (d_raw - state->d[c]) * dt / (settings.tf[c] + dt);
+        state->prev_meas[c] = meas[c];
+
+        float u = kp * err + state->i[c] + kd * state->d[c] + (ff ? kff * ff[c] : 0);
+        float out = u < settings.out_min[c] ? settings.out_min[c] : (u > settings.out_max[c] ? settings.out_max[c] : u);
+        state->i[c] += (ki * err + settings.kaw[c] * (out - u)) * dt;
+        state->out[c] = out;
+    }
+    return state->out;
+}
+
+template<uint32_t N>
+void pid_bank_reset(PID_bank_state_t<N>* state) {
+    *state = PID_bank_state_t<N>();
+}
@@ -0,0 +1,65 @@
+#include "relay_tuner.h"
+
+#include <cmath>
+
+void relay_tuner_start(RelayTuner* tuner, const RelayTunerSettings& settings) {
+    *tuner = RelayTuner();
+    tuner->settings = settings;
+    tuner->state = RELAY_RUNNING;
+}
+
+/**
+ * @brief Relay output for this cycle, ends the experiment after settings.periods
+ * full oscillations
+ *
+ * @return turn, as from steering PID
+ */
+float relay_tuner_step(RelayTuner* tuner, const LineEstimate& line, float dt) {
+    auto& s = tuner->settings;
+    if (tuner->state != RELAY_RUNNING) {
+        return 0;
+    }
+    tuner->time += dt;
+    if (line.line_lost || tuner->time > s.timeout_s) {
+        tuner->state = RELAY_FAILED;
+        return 0;
+    }
+
+    tuner->pos_max = fmaxf(tuner->pos_max, line.position);
+    tuner->pos_min = fminf(tuner->pos_min, line.position);
+    if (tuner->output < 0 && line.position > s.hysteresis) {
+        tuner->output = 1;
+        // first rise ends transient from start, measure from the second one
+        if (tuner->rises++) {
+            tuner->period_sum += tuner->time - tuner->last_rise;
+            tuner->amplitude_sum += 0.5f * (tuner->pos_max - tuner->pos_min);
+            tuner->periods++;
+        }
+        tuner->last_rise = tuner->time;
+        tuner->pos_max = tuner->pos_min = line.position;
+    } else if (tuner->output > 0 && line.position < -s.hysteresis) {
+        tuner->output = -1;
+    }
+
+    if (tuner->periods && tuner->periods >= s.periods) {
+        float a = tuner->amplitude_sum / tuner->periods;
+        // describing function of relay with hysteresis
+        float a_eff = sqrtf(fmaxf(a * a - s.hysteresis * s.hysteresis, 1e-6f));
+        tuner->ku = 4 * s.amplitude / (float(M_PI) * a_eff);
+        tuner->tu = tuner->period_sum / tuner->periods;
+        tuner->state = RELAY_DONE;
+        return 0;
+    }
+    return tuner->output * s.amplitude;
+}
+
+/* Ziegler-Nichols PID from the experiment, starting point for the optimizer */
+LineFollowerGains relay_tuner_gains(const RelayTuner& tuner) {
+    float kp = 0.6f * tuner.ku;
+    return {
+        .base_duty = tuner.settings.base_duty,
+        .kp = kp,
+        .ki = kp / (0.5f * tuner.tu),
+        .kd = kp * 0.125f * tuner.tu,
+    };
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "line_follower.h"
+
+/**
+ * @brief Relay feedback experiment (Astrom-Hagglund): steering is switched
+ * between +-amplitude by the side of the line, the robot oscillates around
+ * it with ultimate period Tu, amplitude gives ultimate gain Ku.
+ */
+struct RelayTunerSettings {
+    float amplitude = 0.1f;   // turn duty
+    float hysteresis = 0.2f;  // [pitch], against noise
+    float base_duty = 0.1f;   // forward speed during experiment
+    uint32_t periods = 6;     // measured after the first one
+    float timeout_s = 10;
+};
+
+enum RelayTunerState : uint8_t {
+    RELAY_IDLE,
+    RELAY_RUNNING,
+    RELAY_DONE,
+    RELAY_FAILED,  // line lost or no oscillation before timeout
+};
+
+struct RelayTuner {
+    RelayTunerSettings settings;
+    RelayTunerState state = RELAY_IDLE;
+    float output = 1;
+    float time = 0;
+    float last_rise = 0;
+    float pos_max = 0, pos_min = 0;
+    uint32_t rises = 0;
+    float period_sum = 0, amplitude_sum = 0;
+    uint32_t periods = 0;
+    // results
+    float ku = 0, tu = 0;
+};
+
+void relay_tuner_start(RelayTuner* tuner, const RelayTunerSettings& settings);
+float relay_tuner_step(RelayTuner* tuner, const LineEstimate& line, float dt);
+LineFollowerGains relay_tuner_gains(const RelayTuner& tuner);
@@ -0,0 +1,171 @@
+/* Sensor acquisition pipelined with the control loop */
+#include "sensors.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#if SENSORS_USE_BATTERY
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <esp_adc/adc_oneshot.h>
+#endif
+
+#include "../as5055/as5055.h"
+#include "../ads7138/registers.h"
+#include "../cores.h"
+#include "../logging/binary_logging.h"
+#include "line_calibration.h"
+#include "triple_buffer.h"
+
+static const char TAG[] = "sensors";
+
+TaskHandle_t sensors_task_handle = NULL;
+
+static TripleBuffer<SensorFrame> sensor_frames;
+
+LineEstimator line_estimator;
+static LineEstimate line_estimate_result;
+#if SENSORS_USE_ENCODER
+static bool encoder_started = false;
+#endif
+
+#if SENSORS_USE_BATTERY
+static adc_oneshot_unit_handle_t battery_adc;
+static adc_cali_handle_t battery_cali;
+
+static void battery_init()
+{
+    adc_oneshot_unit_init_cfg_t unit_config = {};
+    unit_config.unit_id = ADC_UNIT_1;
+    ESP_ERROR_CHECK(adc_oneshot_new_unit(&unit_config, &battery_adc));
+    adc_oneshot_chan_cfg_t channel_config = {};
+    channel_config.atten = ADC_ATTEN_DB_11;
+    channel_config.bitwidth = ADC_BITWIDTH_DEFAULT;
+    ESP_ERROR_CHECK(adc_oneshot_config_channel(
+        battery_adc, SENSORS_BATTERY_ADC_CHANNEL, &channel_config));
+    adc_cali_curve_fitting_config_t cali_config = {};
+    cali_config.unit_id = ADC_UNIT_1;
+    cali_config.chan = SENSORS_BATTERY_ADC_CHANNEL;
+    cali_config.atten = ADC_ATTEN_DB_11;
+    cali_config.bitwidth = ADC_BITWIDTH_DEFAULT;
+    ESP_ERROR_CHECK(
+        adc_cali_create_scheme_curve_fitting(&cali_config, &battery_cali));
+}
+
+/* [V], 0 if reading failed */
+static float battery_read()
+{
+    int raw, mv;
+    if (adc_oneshot_read(battery_adc, SENSORS_BATTERY_ADC_CHANNEL, &raw)
+            != ESP_OK
+        || adc_cali_raw_to_voltage(battery_cali, raw, &mv) != ESP_OK)
+    {
+        return 0;
+    }
+    return mv * 0.001f * SENSORS_BATTERY_DIVIDER;
+}
+#endif
+
+/**
+ * @brief Reads one frame per request, bus transactions of next frame run
+ * while control task computes on previous one
+ */
+static void sensors_task(void* pvParameters)
+{
+    uint32_t seq = 0;
+    float battery_v = 0;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        auto& frame = sensor_frames.back_buffer();
+        frame.seq = seq++;
+        frame.timestamp_us = esp_timer_get_time();
+        ads7138_read_data(
+            RECENT_CH0_LSB, (uint8_t*)&frame.line, sizeof(frame.line));
+        frame.imu = mpu6500_read_sensors();
+#if SENSORS_USE_ENCODER
+        frame.encoder = encoder_started ? as5055_read_angle_data() : 0;
+#endif
+#if SENSORS_USE_BATTERY
+        if (frame.seq % SENSORS_BATTERY_PERIOD == 0)
+        {
+            battery_v = battery_read();
+        }
+#endif
+        frame.battery_v = battery_v;
+        frame.read_us = esp_timer_get_time() - frame.timestamp_us;
+        sensor_frames.publish();
+    }
+    vTaskDelete(NULL);
+}
+
+void sensors_start()
+{
+    line_estimator_init(&line_estimator);
+    line_calibration_load(&line_estimator);
+    ads7138_init();
+    mpu6500_init();
+#if SENSORS_USE_ENCODER
+    encoder_started = as5055_init();
+#endif
+#if SENSORS_USE_BATTERY
+    battery_init();
+#endif
+
+    /* same core as control loop, lower priority - runs in its idle time */
+    xTaskCreatePinnedToCore(
+        &sensors_task,
+        "sensors_task",
+        4096,
+        NULL,
+        configMAX_PRIORITIES - 3,
+        &sensors_task_handle,
+        CORE_CONTROL);
+    ESP_LOGI(TAG, "Sensor task started!");
+    xTaskNotifyGive(sensors_task_handle);
+}
+
+/**
+ * @brief Take newest frame and start acquisition of the next one
+ *
+ * @return false if no frame was finished since last call
+ */
+bool sensors_update()
+{
+    auto fresh = sensor_frames.update();
+    xTaskNotifyGive(sensors_task_handle);
+    return fresh;
+}
+
+/* Frame taken by last sensors_update, only for control task */
+const SensorFrame& sensors_frame() { return sensor_frames.front_buffer(); }
+
+/* ControlStages::read_sensors */
+void sensors_read_stage(float dt)
+{
+    auto fresh = sensors_update();
+    auto& frame = sensors_frame();
+    uint32_t age_us = esp_timer_get_time() - frame.timestamp_us;
+    uint16_t line[8];  // ads7138_struct is packed, no reference to it
+    memcpy(line, frame.line.ain, sizeof(line));
+    LOG_VALUES_DELTA(
+        "sensor_frame", frame.seq, fresh, age_us, frame.read_us, line);
+}
+
+/* Line estimate of the frame from last sensors_update */
+const LineEstimate& sensors_line() { return line_estimate_result; }
+
+/* ControlStages::estimate */
+void sensors_estimate_stage(float dt)
+{
+    uint16_t raw[LINE_SENSORS];
+    auto& frame = sensors_frame();
+    memcpy(raw, frame.line.ain, sizeof(raw));
+    line_calibration_update(&line_estimator, raw, frame.timestamp_us);
+    line_estimate(&line_estimator, raw, &line_estimate_result);
+    auto& line = line_estimate_result;
+    LOG_VALUES_DELTA(
+        "line", line.position, line.confidence, line.line_lost, line.peak);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../ads7138/ads7138.h"
+#include "../mpu6500/mpu6500.h"
+#include "line_estimator.h"
+
+/* as5055 SPI uses pins 26/27 of I2C_NUM_1 on current board, it is not
+ * started when the bus has them (i2c_bus_claim_pins) */
+#define SENSORS_USE_ENCODER 0
+
+/* IMU mounting, signs turning gyro Z and accel X into robot frame:
+ * yaw positive to the left, acceleration positive forward */
+#define SENSORS_IMU_YAW_SIGN 1.f
+#define SENSORS_IMU_FORWARD_SIGN 1.f
+
+/* Battery through a divider on ADC1 of the ESP, all ADS7138 channels are
+ * line sensors. Divider not fitted on current board. */
+#define SENSORS_USE_BATTERY 0
+#define SENSORS_BATTERY_ADC_CHANNEL ADC_CHANNEL_0
+#define SENSORS_BATTERY_DIVIDER 3.f  // (R_top + R_bottom) / R_bottom
+#define SENSORS_BATTERY_PERIOD 100   // frames between readings
+
+/* All sensors read in one acquisition */
+struct SensorFrame
+{
+    uint32_t seq;
+    int64_t timestamp_us;  // start of acquisition
+    uint32_t read_us;      // bus time of the whole frame
+    ads7138_struct line;
+    mpu6500_data imu;
+    uint16_t encoder;
+    float battery_v;  // 0 - not measured
+};
+
+void sensors_start();
+bool sensors_update();
+const SensorFrame& sensors_frame();
+void sensors_read_stage(float dt);
+
+extern LineEstimator line_estimator;
+const LineEstimate& sensors_line();
+void sensors_estimate_stage(float dt);
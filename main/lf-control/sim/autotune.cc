@@ -0,0 +1,219 @@
+// g++ autotune.cc ../line_estimator.cc ../line_follower.cc ../pid.cc ../relay_tuner.cc -o autotune.e -std=c++17 -O2 -s -pthread && ./autotune.e [dir]
+/**
+ * Host steering gain tuner. For every speed of the gain schedule the relay
+ * experiment (same code as on the robot) gives Ziegler-Nichols gains, then
+ * cross-entropy search over simulated laps improves them. Result is
+ * LineFollowerSettings as raw bytes, ready for POST /line_follower.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#define likely(v) __builtin_expect(!!(v), 1)
+#define unlikely(v) __builtin_expect(!!(v), 0)
+
+#include "../relay_tuner.h"
+#include "sim_run.h"
+
+using namespace std;
+
+#define TUNE_ITERATIONS 10
+#define TUNE_POPULATION 32
+#define TUNE_ELITES 6
+#define TUNE_SEEDS 2
+/* Lap time worth 1 mm of mean tracking error [s] */
+#define TUNE_ERROR_WEIGHT 0.02f
+
+static const float schedule_duty[LF_SCHEDULE_POINTS] = {
+    0.1f, 0.15f, 0.2f, 0.25f};
+
+/* Lower is better, laps not finished cost more than any finished one */
+static float lap_cost(const SimTrack& track, const SimResult& r)
+{
+    if (r.off_track || !r.lap_time_s)
+    {
+        return 1000 - 100 * r.distance / track.length();
+    }
+    return r.lap_time_s + TUNE_ERROR_WEIGHT * r.mean_abs_error * 1000;
+}
+
+static bool relay_experiment(
+    const SimTrack& track, float base_duty, LineFollowerGains* gains)
+{
+    RelayTuner tuner;
+    RelayTunerSettings settings;
+    settings.base_duty = base_duty;
+    relay_tuner_start(&tuner, settings);
+    sim_run(
+        track,
+        1,
+        settings.timeout_s + 1,
+        "",
+        [&](const LineEstimate& line,
+            const SimRobot&,
+            float dt,
+            MotorDuty* duty)
+        {
+            float turn = relay_tuner_step(&tuner, line, dt);
+            *duty = line_follower_mix(settings.base_duty, turn);
+            return tuner.state == RELAY_RUNNING;
+        });
+    if (tuner.state != RELAY_DONE)
+    {
+        return false;
+    }
+    *gains = relay_tuner_gains(tuner);
+    printf(
+        "relay duty %.2f: Ku %.4f Tu %.3f s -> kp %.4f ki %.4f kd %.5f\n",
+        base_duty,
+        tuner.ku,
+        tuner.tu,
+        gains->kp,
+        gains->ki,
+        gains->kd);
+    return true;
+}
+
+/**
+ * @brief Cross-entropy search in log space of kp, ki, kd, mean starts at
+ * relay gains, spread shrinks to the elite candidates every iteration
+ */
+static LineFollowerGains optimize(
+    const SimTrack& track, LineFollowerGains start, float* best_cost)
+{
+    mt19937 rng(start.base_duty * 1000);
+    float mean[3] = {
+        logf(start.kp),
+        logf(fmaxf(start.ki, 1e-3f)),
+        logf(fmaxf(start.kd, 1e-4f))};
+    float sigma[3] = {1, 1.5f, 1.5f};
+    LineFollowerGains best = start;
+    *best_cost = INFINITY;
+    // 3x lap time at full speed of base duty
+    const float lap_limit_s =
+        3 * track.length() / (start.base_duty * 2 * SimRobotParams().v_max);
+
+    for (int it = 0; it < TUNE_ITERATIONS; it++)
+    {
+        vector<LineFollowerGains> candidates(TUNE_POPULATION);
+        vector<float> cost(TUNE_POPULATION, 0);
+        vector<float> seed_cost(TUNE_POPULATION * TUNE_SEEDS);
+        for (uint32_t c = 0; c < TUNE_POPULATION; c++)
+        {
+            float g[3];
+            for (int k = 0; k < 3; k++)
+            {
+                // first candidate keeps the mean
+                float z = c ? normal_distribution<float>()(rng) : 0;
+                g[k] = expf(mean[k] + sigma[k] * z);
+            }
+            candidates[c] = {start.base_duty, g[0], g[1], g[2]};
+        }
+        parallel_for(
+            TUNE_POPULATION * TUNE_SEEDS,
+            [&](uint32_t i)
+            {
+                auto c = i / TUNE_SEEDS;
+                auto r = sim_run(
+                    track,
+                    100 + i % TUNE_SEEDS,
+                    lap_limit_s,
+                    "",
+                    sim_line_follower(sim_settings(candidates[c])),
+                    1);
+                seed_cost[i] = lap_cost(track, r);
+            });
+        for (uint32_t i = 0; i < seed_cost.size(); i++)
+        {
+            cost[i / TUNE_SEEDS] += seed_cost[i] / TUNE_SEEDS;
+        }
+
+        vector<uint32_t> order(TUNE_POPULATION);
+        for (uint32_t c = 0; c < TUNE_POPULATION; c++)
+        {
+            order[c] = c;
+        }
+        sort(
+            order.begin(),
+            order.end(),
+            [&](uint32_t a, uint32_t b) { return cost[a] < cost[b]; });
+        if (cost[order[0]] < *best_cost)
+        {
+            *best_cost = cost[order[0]];
+            best = candidates[order[0]];
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            float m = 0, v = 0;
+            for (int e = 0; e < TUNE_ELITES; e++)
+            {
+                auto& g = candidates[order[e]];
+                float x = logf(k == 0 ? g.kp : (k == 1 ? g.ki : g.kd));
+                m += x / TUNE_ELITES;
+                v += x * x / TUNE_ELITES;
+            }
+            mean[k] = m;
+            sigma[k] = sqrtf(fmaxf(v - m * m, 0.f)) + 0.05f;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    string dir = argc > 1 ? argv[1] : "/dev/shm";
+    const auto track = sim_default_track();
+    auto start = chrono::steady_clock::now();
+
+    auto result = sim_settings({schedule_duty[0], 0.05f, 0, 0});
+    for (uint32_t p = 0; p < LF_SCHEDULE_POINTS; p++)
+    {
+        LineFollowerGains gains = {schedule_duty[p], 0.05f, 0.01f, 0.001f};
+        if (!relay_experiment(track, schedule_duty[p], &gains))
+        {
+            printf(
+                "relay duty %.2f: no oscillation, default start\n",
+                schedule_duty[p]);
+        }
+        float cost;
+        auto g = optimize(track, gains, &cost);
+        line_follower_set_schedule(&result.steering, p, g);
+        auto r = sim_run(
+            track,
+            7,
+            30,
+            dir + "/autotune_" + to_string(p),
+            sim_line_follower(sim_settings(g)),
+            1);
+        printf(
+            "tuned duty %.2f: kp %.4f ki %.4f kd %.5f cost %.3f lap %.3f s "
+            "mean err %.1f mm\n",
+            g.base_duty,
+            g.kp,
+            g.ki,
+            g.kd,
+            cost,
+            r.lap_time_s,
+            r.mean_abs_error * 1000);
+    }
+    chrono::duration<double> total = chrono::steady_clock::now() - start;
+    printf(
+        "%d simulated laps in %.1f s\n",
+        LF_SCHEDULE_POINTS * TUNE_ITERATIONS * TUNE_POPULATION * TUNE_SEEDS,
+        total.count());
+
+    auto fname = dir + "/line_follower.bin";
+    auto F = fopen(fname.c_str(), "wb");
+    fwrite(&result, sizeof(result), 1, F);
+    fclose(F);
+    printf(
+        "curl --data-binary @%s http://10.10.128.1/line_follower\n",
+        fname.c_str());
+    return 0;
+}
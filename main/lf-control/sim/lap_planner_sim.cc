@@ -0,0 +1,144 @@
+// g++ lap_planner_sim.cc ../line_estimator.cc ../line_follower.cc ../pid.cc ../track_map.cc -o lap_planner_sim.e -std=c++17 -O2 -s && ./lap_planner_sim.e [dir]
+/**
+ * Track map learning and speed profile in the simulator: slow learning lap,
+ * map built from curvature of motor duties against encoder distance, then
+ * laps with the speed profile compared to the best constant speed.
+ */
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#define likely(v) __builtin_expect(!!(v), 1)
+#define unlikely(v) __builtin_expect(!!(v), 0)
+
+#include "../odometry.h"
+#include "../track_map.h"
+#include "sim_run.h"
+
+using namespace std;
+
+#define SIM_RACE_LAPS 3
+/* Runs further from the line do not count, sensors would lose it on a
+ * real track with crossings */
+#define SIM_MAX_ERROR 0.02f
+
+int main(int argc, char** argv)
+{
+    string dir = argc > 1 ? argv[1] : "/dev/shm";
+    const auto track = sim_default_track();
+
+    // learning lap at low constant speed
+    auto settings = sim_race_settings(0.1f);
+    static TrackMapRecorder recorder;
+    track_map_record_start(&recorder);
+    Odometry odometry;
+    auto learn = sim_line_follower(settings);
+    auto r = sim_run(
+        track,
+        1,
+        60,
+        dir + "/planner_learn",
+        [&](const LineEstimate& line,
+            const SimRobot& robot,
+            float dt,
+            MotorDuty* duty)
+        {
+            learn(line, robot, dt, duty);
+            odometry_update_encoder(&odometry, robot.encoder_raw(), dt);
+            track_map_record(
+                &recorder, odometry.distance, motor_duty_curvature(*duty));
+            return true;
+        },
+        1);
+    printf(
+        "learning lap %.2f s, odometry %.2f m, track %.2f m\n",
+        r.lap_time_s,
+        odometry.distance,
+        track.length());
+
+    static TrackMap map;
+    SpeedProfileSettings profile;
+    profile.v_max = 0.95f * LF_WHEEL_SPEED_MAX;
+    track_map_build(recorder, profile, &map);
+    printf("%" PRIu32 " segments:\n", map.segments);
+    for (uint32_t k = 0; k < map.segments; k++)
+    {
+        auto& s = map.segment[k];
+        printf(
+            "  %6.2f m +%5.2f m  curvature %6.2f 1/m  limit %4.2f entry %4.2f "
+            "m/s\n",
+            s.start,
+            s.length,
+            s.curvature,
+            s.v_limit,
+            s.v_entry);
+    }
+    track_map_save(map, (dir + "/track_map.bin").c_str());
+    TrackMap loaded;
+    if (!track_map_load(&loaded, (dir + "/track_map.bin").c_str())
+        || loaded.segments != map.segments)
+    {
+        printf("map save / load failed\n");
+        return 1;
+    }
+
+    // best constant speed staying on the track
+    float best_constant = 0, best_duty = 0;
+    for (float duty = 0.1f; duty < 0.5f; duty += 0.01f)
+    {
+        settings.base_duty = duty;
+        auto c = sim_run(
+            track, 2, 60, "", sim_line_follower(settings), SIM_RACE_LAPS);
+        if (c.off_track || !c.finish_time_s || c.max_abs_error > SIM_MAX_ERROR)
+        {
+            break;
+        }
+        best_constant = c.finish_time_s;
+        best_duty = duty;
+    }
+    printf(
+        "best constant duty %.2f: %d laps %.2f s\n",
+        best_duty,
+        SIM_RACE_LAPS,
+        best_constant);
+
+    // speed profile, odometry from lap start
+    Odometry race_odometry;
+    LineFollowerState state;
+    TrackMapFollower follower;
+    MotorDuty last_duty = {LF_DUTY_STOP, LF_DUTY_STOP};
+    auto race = sim_run(
+        track,
+        2,
+        60,
+        dir + "/planner_race",
+        [&](const LineEstimate& line,
+            const SimRobot& robot,
+            float dt,
+            MotorDuty* duty)
+        {
+            odometry_update_encoder(&race_odometry, robot.encoder_raw(), dt);
+            float v = track_map_follow(
+                map,
+                &follower,
+                race_odometry.distance,
+                motor_duty_curvature(last_duty),
+                dt);
+            *duty = line_follower_step(
+                settings, &state, line, motor_speed_duty(v), dt);
+            last_duty = *duty;
+            return true;
+        },
+        SIM_RACE_LAPS);
+    printf(
+        "speed profile: %d laps %.2f s (off track %d, max err %.1f mm), "
+        "%" PRIu32 " syncs\n",
+        SIM_RACE_LAPS,
+        race.finish_time_s,
+        race.off_track,
+        race.max_abs_error * 1000,
+        follower.syncs);
+    return 0;
+}
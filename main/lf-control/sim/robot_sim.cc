@@ -0,0 +1,138 @@
+// g++ robot_sim.cc ../line_estimator.cc ../line_follower.cc ../pid.cc -o robot_sim.e -std=c++17 -O2 -s -pthread && ./robot_sim.e [dir] [seconds]
+/**
+ * Host closed loop simulator: the robot control code (line estimator, PID,
+ * line follower step) drives simulated robot on a simulated track. Runs a
+ * grid of settings on all cores, every run is logged to .blog like on the
+ * robot, so load_logs.py and plots work for both.
+ */
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define likely(v) __builtin_expect(!!(v), 1)
+#define unlikely(v) __builtin_expect(!!(v), 0)
+
+#include "sim_run.h"
+
+using namespace std;
+
+struct SimRun
+{
+    LineFollowerSettings settings;
+    uint32_t seed;
+    SimResult result;
+};
+
+int main(int argc, char** argv)
+{
+    string dir = argc > 1 ? argv[1] : "/dev/shm";
+    float duration_s = argc > 2 ? atof(argv[2]) : 20;
+    const auto track = sim_default_track();
+
+    vector<SimRun> runs;
+    for (float base : {0.1f, 0.15f, 0.2f, 0.25f})
+    {
+        for (float kp : {0.02f, 0.05f, 0.1f, 0.15f, 0.2f})
+        {
+            for (float kd : {0.f, 0.001f, 0.002f, 0.005f})
+            {
+                SimRun run;
+                run.settings = sim_settings({base, kp, 0, kd});
+                run.seed = runs.size() + 1;
+                runs.push_back(run);
+            }
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    parallel_for(
+        runs.size(),
+        [&](uint32_t i)
+        {
+            char base[64];
+            snprintf(base, sizeof(base), "/sim_%03" PRIu32, i);
+            runs[i].result = sim_run(
+                track,
+                runs[i].seed,
+                duration_s,
+                dir + base,
+                sim_line_follower(runs[i].settings));
+        });
+    chrono::duration<double> total = chrono::steady_clock::now() - start;
+
+    auto F = fopen((dir + "/sim_summary.csv").c_str(), "w");
+    fprintf(
+        F,
+        "run,base_duty,kp,kd,off_track,time_s,distance_m,speed_ms,"
+        "mean_err_mm,max_err_mm,lost_cycles\n");
+    vector<uint32_t> order(runs.size());
+    for (uint32_t i = 0; i < runs.size(); i++)
+    {
+        order[i] = i;
+        auto& r = runs[i].result;
+        auto& settings = runs[i].settings;
+        fprintf(
+            F,
+            "%" PRIu32 ",%.3f,%.4f,%.4f,%d,%.3f,%.3f,%.3f,%.2f,%.2f,%" PRIu32
+            "\n",
+            i,
+            settings.base_duty,
+            settings.steering.kp[0][0],
+            settings.steering.kd[0][0],
+            r.off_track,
+            r.time_s,
+            r.distance,
+            r.distance / r.time_s,
+            r.mean_abs_error * 1000,
+            r.max_abs_error * 1000,
+            r.lost_cycles);
+    }
+    fclose(F);
+
+    // fastest runs staying on track first, then the most accurate
+    sort(
+        order.begin(),
+        order.end(),
+        [&](uint32_t a, uint32_t b)
+        {
+            auto &ra = runs[a].result, &rb = runs[b].result;
+            if (ra.off_track != rb.off_track)
+            {
+                return rb.off_track;
+            }
+            float va = ra.distance / ra.time_s, vb = rb.distance / rb.time_s;
+            if (fabsf(va - vb) > 0.01f)
+            {
+                return va > vb;
+            }
+            return ra.mean_abs_error < rb.mean_abs_error;
+        });
+    printf(
+        "%zu runs of %.0f s on %.2f m track in %.2f s (%.0fx real time)\n",
+        runs.size(),
+        duration_s,
+        track.length(),
+        total.count(),
+        runs.size() * duration_s / total.count());
+    printf(" run  base    kp     kd    off speed  mean err  max err\n");
+    for (uint32_t i = 0; i < min<size_t>(10, order.size()); i++)
+    {
+        auto& r = runs[order[i]].result;
+        auto& settings = runs[order[i]].settings;
+        printf(
+            "%4" PRIu32 " %5.2f %6.3f %6.4f %3d %5.2f m/s %5.1f mm %5.1f mm\n",
+            order[i],
+            settings.base_duty,
+            settings.steering.kp[0][0],
+            settings.steering.kd[0][0],
+            r.off_track,
+            r.distance / r.time_s,
+            r.mean_abs_error * 1000,
+            r.max_abs_error * 1000);
+    }
+    return 0;
+}
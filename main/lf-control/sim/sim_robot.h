@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+#include "../line_estimator.h"
+#include "../line_follower.h"
+#include "../odometry.h"
+#include "sim_track.h"
+
+/* Physical parameters of the simulated robot */
+struct SimRobotParams
+{
+    float wheel_base = LF_WHEEL_BASE_M;
+    float v_max = LF_WHEEL_SPEED_MAX;  // wheel speed at full duty [m/s]
+    float motor_tau = 0.04f;     // motor + robot mechanical time constant [s]
+    float sensor_ahead = 0.08f;  // sensor array in front of wheel axis [m]
+    float sensor_pitch = 0.008f; // [m]
+    float sensor_spot = 0.003f;  // sigma of seen floor area [m]
+    uint16_t background = 6000;  // raw reading over the floor
+    uint16_t line = 48000;       // raw reading over the line
+    float gain_spread = 0.1f;    // channel sensitivity differences
+    float noise = 400;           // raw reading noise sigma
+    float grip = 9.f;            // max lateral acceleration, then slides [m/s^2]
+};
+
+/**
+ * @brief Differential drive on a flat floor, wheels follow duty through
+ * first order lag. Duty is mapped like locked anti-phase H-bridge:
+ * 0.5 - stop, 0.01 / 0.99 - full reverse / forward.
+ */
+class SimRobot
+{
+   public:
+    SimRobotParams p;
+    float x = 0, y = 0, heading = 0;
+    float v_left = 0, v_right = 0;
+    float travelled = 0;
+    uint32_t hint = 0;  // nearest track point of the sensor array
+    float gain[LINE_SENSORS];
+    std::mt19937 rng;
+
+    SimRobot(const SimRobotParams& params, uint32_t seed) : p(params), rng(seed)
+    {
+        std::uniform_real_distribution<float> g(
+            1 - p.gain_spread, 1 + p.gain_spread);
+        for (auto& k : gain)
+        {
+            k = g(rng);
+        }
+    }
+
+    void step(float duty_left, float duty_right, float dt)
+    {
+        float target_left = (2 * duty_left - 1) * p.v_max;
+        float target_right = (2 * duty_right - 1) * p.v_max;
+        // motor lag, wheel speed change limited by tyre grip
+        float max_dv = p.grip * dt;
+        float dv_left = (target_left - v_left) * dt / p.motor_tau;
+        float dv_right = (target_right - v_right) * dt / p.motor_tau;
+        v_left += fminf(fmaxf(dv_left, -max_dv), max_dv);
+        v_right += fminf(fmaxf(dv_right, -max_dv), max_dv);
+
+        float v = 0.5f * (v_left + v_right);
+        float w = (v_right - v_left) / p.wheel_base;
+        // tyres slide, robot turns less than wheels command
+        float w_grip = p.grip / fmaxf(fabsf(v), 1e-3f);
+        w = fminf(fmaxf(w, -w_grip), w_grip);
+        x += v * cosf(heading) * dt;
+        y += v * sinf(heading) * dt;
+        heading += w * dt;
+        travelled += v * dt;
+    }
+
+    /* as5055_read_angle_data() of encoder turning with travelled distance */
+    uint16_t encoder_raw() const
+    {
+        float turns = travelled / (2 * 3.141592f * ODOMETRY_WHEEL_RADIUS_M);
+        int64_t count = llroundf(turns * ODOMETRY_ENCODER_COUNTS);
+        return uint16_t((count & (ODOMETRY_ENCODER_COUNTS - 1)) << 2);
+    }
+
+    /* Middle of the sensor array, signed distance from the line */
+    float lateral_error(const SimTrack& track)
+    {
+        return track.lateral(
+            x + p.sensor_ahead * cosf(heading),
+            y + p.sensor_ahead * sinf(heading),
+            &hint);
+    }
+
+    /**
+     * @brief ADS7138 readings, sensor LINE_SENSORS - 1 is on the left.
+     * Each sensor sees gaussian spot, reading is the part of it on the tape.
+     */
+    void read_sensors(const SimTrack& track, uint16_t raw[LINE_SENSORS])
+    {
+        std::normal_distribution<float> noise(0, p.noise);
+        float c = cosf(heading), s = sinf(heading);
+        for (uint32_t k = 0; k < LINE_SENSORS; k++)
+        {
+            float side = (float(k) - LINE_POSITION_MAX) * p.sensor_pitch;
+            float sx = x + p.sensor_ahead * c - side * s;
+            float sy = y + p.sensor_ahead * s + side * c;
+            uint32_t h = hint;
+            float d = track.distance(sx, sy, &h, 16);
+            float half = 0.5f * track.line_width;
+            float k2 = 1 / (sqrtf(2.f) * p.sensor_spot);
+            float cover =
+                0.5f * (erff((half - d) * k2) + erff((half + d) * k2));
+            float v = (p.background + (p.line - p.background) * cover) * gain[k]
+                      + noise(rng);
+            raw[k] = uint16_t(fminf(fmaxf(v, 0.f), 65535.f));
+        }
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../logging/binary_logging.h"
+#include "../control_loop.h"
+#include "../line_estimator.h"
+#include "../line_follower.h"
+#include "sim_robot.h"
+#include "sim_track.h"
+
+/* Physics steps per control cycle */
+#define SIM_SUBSTEPS 4
+/* Sensor array this far from the line - robot left the track */
+#define SIM_OFF_TRACK 0.06f
+/* Steering of race laps in lap_planner_sim and wheel_speed_sim */
+#define SIM_RACE_KP 0.6f
+#define SIM_RACE_KD 0.006f
+
+struct SimResult
+{
+    bool off_track = false;
+    float time_s = 0;
+    float lap_time_s = 0;     // first lap, 0 - not finished
+    float finish_time_s = 0;  // all laps of the run, 0 - not finished
+    float distance = 0;
+    float mean_abs_error = 0;  // [m]
+    float max_abs_error = 0;
+    uint32_t lost_cycles = 0;
+};
+
+using sim_record_t = LogRecord<
+    uint32_t, float, float, float, float, float, float, float, uint8_t>;
+static constexpr auto sim_json_descr = sim_record_t::json_descr(
+    "t_us,x,y,heading,lateral,position,duty_left,duty_right,lost");
+
+/**
+ * @brief Run robot on the track at control loop rate
+ *
+ * @param log_base .blog/.bidx file name without extension, empty - no log
+ * @param control bool(const LineEstimate&, const SimRobot&, float dt,
+ * MotorDuty*), returns false to end the run, robot only for what
+ * sensors measure: encoder_raw(), wheel speeds
+ * @param laps end of the run, 0 - run whole duration
+ * @param params robot, e.g. v_max for other battery voltage
+ */
+template <class Tcontrol>
+SimResult sim_run(
+    const SimTrack& track,
+    uint32_t seed,
+    float duration_s,
+    const std::string& log_base,
+    Tcontrol control,
+    uint32_t laps = 0,
+    const SimRobotParams& params = SimRobotParams())
+{
+    SimRobot robot(params, seed);
+    const uint32_t rate_hz = CONTROL_LOOP_DEFAULT_RATE_HZ;
+    const float dt = 1.f / rate_hz;
+    SimResult result;
+
+    // calibration as done by line_calibration sweep
+    LineEstimator estimator;
+    line_estimator_init(&estimator);
+    uint16_t background[LINE_SENSORS], line[LINE_SENSORS];
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        background[k] = uint16_t(params.background * robot.gain[k]);
+        line[k] = uint16_t(params.line * robot.gain[k]);
+    }
+    line_estimator_calibrate(&estimator, background, line);
+
+    LogWriter<StdioLogFile> writer;
+    if (!log_base.empty())
+    {
+        writer.open(
+            (log_base + ".blog").c_str(), (log_base + ".bidx").c_str(), 0, 0);
+    }
+    const LogStreamDescr stream = {
+        .name = "sim",
+        .json_descr = sim_json_descr.c_str(),
+        .layout = sim_record_t::layout.c_str(),
+        .record_size = sim_record_t::size,
+        .flags = LOG_STREAM_DELTA,
+    };
+    uint8_t buf[MAX_LOG_RECORD_SIZE];
+
+    LineEstimate estimate;
+    uint16_t raw[LINE_SENSORS];
+    robot.lateral_error(track);
+    robot.read_sensors(track, raw);
+
+    uint32_t cycles = duration_s * rate_hz;
+    double error_sum = 0;
+    uint32_t cycle = 0;
+    while (cycle < cycles)
+    {
+        // frame read during previous cycle, like sensors_task pipeline
+        line_estimate(&estimator, raw, &estimate);
+        MotorDuty duty;
+        if (!control(estimate, robot, dt, &duty))
+        {
+            break;
+        }
+        float lateral = robot.lateral_error(track);
+        robot.read_sensors(track, raw);
+        for (int s = 0; s < SIM_SUBSTEPS; s++)
+        {
+            robot.step(duty.left, duty.right, dt / SIM_SUBSTEPS);
+        }
+
+        if (!log_base.empty())
+        {
+            sim_record_t::assemble(
+                buf,
+                uint32_t(cycle * 1000000ull / rate_hz),
+                robot.x,
+                robot.y,
+                robot.heading,
+                lateral,
+                estimate.position,
+                duty.left,
+                duty.right,
+                uint8_t(estimate.line_lost));
+            writer.write(
+                0,
+                stream,
+                buf,
+                sim_record_t::size,
+                cycle * 1000000ll / rate_hz);
+        }
+
+        cycle++;
+        error_sum += fabsf(lateral);
+        result.max_abs_error = std::max(result.max_abs_error, fabsf(lateral));
+        result.lost_cycles += estimate.line_lost;
+        if (fabsf(lateral) > SIM_OFF_TRACK)
+        {
+            result.off_track = true;
+            break;
+        }
+        if (!result.lap_time_s && robot.travelled >= track.length())
+        {
+            result.lap_time_s = float(cycle) / rate_hz;
+        }
+        if (laps && robot.travelled >= laps * track.length())
+        {
+            result.finish_time_s = float(cycle) / rate_hz;
+            break;
+        }
+    }
+    if (!log_base.empty())
+    {
+        writer.close();
+    }
+
+    result.time_s = float(cycle) / rate_hz;
+    result.distance = robot.travelled;
+    result.mean_abs_error = cycle ? error_sum / cycle : 0;
+    return result;
+}
+
+/* Line follower control for sim_run */
+inline auto sim_line_follower(const LineFollowerSettings& settings)
+{
+    return [settings, state = LineFollowerState()](
+               const LineEstimate& line,
+               const SimRobot&,
+               float dt,
+               MotorDuty* duty) mutable
+    {
+        *duty = line_follower_step(settings, &state, line, dt);
+        return true;
+    };
+}
+
+/* Settings of every simulator: defaults with constant steering gains */
+inline LineFollowerSettings sim_settings(const LineFollowerGains& gains)
+{
+    LineFollowerSettings settings;
+    settings.base_duty = gains.base_duty;
+    line_follower_set_gains(&settings.steering, gains);
+    return settings;
+}
+
+inline LineFollowerSettings sim_race_settings(float base_duty)
+{
+    return sim_settings({base_duty, SIM_RACE_KP, 0, SIM_RACE_KD});
+}
+
+/* Run fn(i) for i in 0..count on all cores, build with -pthread */
+template <class Tfn>
+void parallel_for(uint32_t count, Tfn fn)
+{
+    std::atomic<uint32_t> next{0};
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < std::max(1u, std::thread::hardware_concurrency());
+         t++)
+    {
+        workers.emplace_back(
+            [&]()
+            {
+                uint32_t i;
+                while ((i = next.fetch_add(1)) < count)
+                {
+                    fn(i);
+                }
+            });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+}
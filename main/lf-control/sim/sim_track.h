@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/* Track element, straight when curvature is 0 */
+struct TrackSegment
+{
+    float length;     // [m]
+    float curvature;  // 1 / radius [1/m], positive - left turn
+};
+
+/**
+ * @brief Closed line on the floor, kept as dense polyline of its middle.
+ * Nearest point search starts from the hint of the previous query, the
+ * robot moves only a few points per step.
+ */
+class SimTrack
+{
+   public:
+    static constexpr float step = 0.002f;  // polyline resolution [m]
+    float line_width = 0.019f;             // black tape [m]
+
+    std::vector<float> x, y, heading;
+
+    explicit SimTrack(const std::vector<TrackSegment>& segments)
+    {
+        float px = 0, py = 0, ph = 0;
+        for (auto& s : segments)
+        {
+            for (float d = 0; d < s.length; d += step)
+            {
+                x.push_back(px);
+                y.push_back(py);
+                heading.push_back(ph);
+                px += step * cosf(ph);
+                py += step * sinf(ph);
+                ph += step * s.curvature;
+            }
+        }
+    }
+
+    uint32_t size() const { return x.size(); }
+    float length() const { return size() * step; }
+
+    /**
+     * @brief Distance of point from the line middle
+     *
+     * @param hint index near the point, updated to the nearest one
+     * @param window points searched on each side of hint
+     */
+    float distance(float px, float py, uint32_t* hint, uint32_t window = 64)
+        const
+    {
+        uint32_t n = size(), best = *hint;
+        float best_d2 = INFINITY;
+        for (uint32_t k = *hint + n - window; k <= *hint + n + window; k++)
+        {
+            uint32_t i = k % n;
+            float dx = px - x[i], dy = py - y[i];
+            float d2 = dx * dx + dy * dy;
+            if (d2 < best_d2)
+            {
+                best_d2 = d2;
+                best = i;
+            }
+        }
+        *hint = best;
+        return sqrtf(best_d2);
+    }
+
+    /* Signed distance, positive - point on the left of the line */
+    float lateral(float px, float py, uint32_t* hint) const
+    {
+        float d = distance(px, py, hint);
+        float h = heading[*hint];
+        float side = cosf(h) * (py - y[*hint]) - sinf(h) * (px - x[*hint]);
+        return side < 0 ? -d : d;
+    }
+};
+
+/* Oval with a chicane on both straights, about 5.4 m */
+inline SimTrack sim_default_track()
+{
+    const float pi = 3.14159265f;
+    const TrackSegment straight = {0.5f, 0};
+    const TrackSegment chicane_in = {pi * 0.25f * 0.3f, 1 / 0.3f};
+    const TrackSegment chicane_out = {pi * 0.25f * 0.3f, -1 / 0.3f};
+    const TrackSegment turn = {pi * 0.4f, 1 / 0.4f};
+    return SimTrack({
+        straight, chicane_in, chicane_out, straight, turn,
+        straight, chicane_in, chicane_out, straight, turn,
+    });
+}
@@ -0,0 +1,188 @@
+// g++ wheel_speed_sim.cc ../line_estimator.cc ../line_follower.cc ../pid.cc ../wheel_speed.cc ../../motors/motor_lut.cc -o wheel_speed_sim.e -std=c++17 -O2 -s && ./wheel_speed_sim.e
+/**
+ * Wheel speed inner loop in the simulator: turn rate and laps at several
+ * battery voltages, open loop duties, duties compensated for battery
+ * voltage by the motors module and the inner loop. Battery voltage scales
+ * top speed of the simulated motors.
+ */
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+#define likely(v) __builtin_expect(!!(v), 1)
+#define unlikely(v) __builtin_expect(!!(v), 0)
+
+#include "../../motors/motor_lut.h"
+#include "../wheel_speed.h"
+#include "sim_run.h"
+
+using namespace std;
+
+#define SIM_LAPS 3
+
+static const float batteries[] = {8.4f, 7.4f, 6.6f};
+
+static SimRobotParams battery_params(float battery_v)
+{
+    SimRobotParams params;
+    params.v_max = LF_WHEEL_SPEED_MAX * battery_v / MOTOR_BATTERY_NOMINAL_V;
+    return params;
+}
+
+enum Drive
+{
+    OPEN_LOOP,
+    COMPENSATED,  // battery compensation of mcpwm_update_motors()
+    INNER_LOOP,   // and wheel speed loop
+};
+
+static const char* const drive_names[] = {"open loop", "compensated", "inner loop"};
+
+/* Simulated motors have no deadband, so no table */
+static MotorDuty motors_module(const MotorDuty& duty, float battery_v)
+{
+    const MotorLut linear = {};
+    return {
+        .left = motor_lut_duty(linear, 0, duty.left, battery_v),
+        .right = motor_lut_duty(linear, 1, duty.right, battery_v),
+    };
+}
+
+/**
+ * @brief Duties of the outer loop through the inner loop, wheel speeds
+ * measured with noise of gyro and encoder
+ */
+struct InnerLoop
+{
+    WheelSpeedController controller;
+    Drive drive;
+    float battery_v;
+    mt19937 rng{3};
+    normal_distribution<float> noise{0, 0.02f};
+
+    InnerLoop(Drive d, float battery) : drive(d), battery_v(battery)
+    {
+        wheel_speed_init(&controller);
+    }
+
+    MotorDuty step(const MotorDuty& command, const SimRobot& robot, float dt)
+    {
+        if (drive == OPEN_LOOP)
+        {
+            return command;
+        }
+        if (drive == COMPENSATED)
+        {
+            return motors_module(command, battery_v);
+        }
+        float setpoint[WHEELS], measured[WHEELS];
+        motor_duty_wheel_speeds(command, setpoint);
+        measured[WHEEL_LEFT] = robot.v_left + noise(rng);
+        measured[WHEEL_RIGHT] = robot.v_right + noise(rng);
+        auto duty = wheel_speed_step(&controller, setpoint, measured, dt);
+        return motors_module(duty, battery_v);
+    }
+};
+
+/* Turn command from standstill: yaw rate after 0.1, 0.25 and 0.5 s, peak
+ * and time after which it stays within 2 % of the command */
+static void turn_rate(float battery_v, Drive drive)
+{
+    SimRobot robot(battery_params(battery_v), 1);
+    InnerLoop loop(drive, battery_v);
+    const float dt = 1.f / CONTROL_LOOP_DEFAULT_RATE_HZ;
+    const MotorDuty command = line_follower_mix(0.1f, 0.1f);
+    const float commanded = 0.1f * 2 * LF_WHEEL_SPEED_MAX / LF_WHEEL_BASE_M;
+    const uint32_t at[] = {
+        CONTROL_LOOP_DEFAULT_RATE_HZ / 10,
+        CONTROL_LOOP_DEFAULT_RATE_HZ / 4,
+        CONTROL_LOOP_DEFAULT_RATE_HZ / 2};
+    float yaw_at[3] = {}, peak = 0, settled_s = 0;
+    for (uint32_t i = 1; i <= 3 * CONTROL_LOOP_DEFAULT_RATE_HZ; i++)
+    {
+        auto duty = loop.step(command, robot, dt);
+        for (int s = 0; s < SIM_SUBSTEPS; s++)
+        {
+            robot.step(duty.left, duty.right, dt / SIM_SUBSTEPS);
+        }
+        float yaw_rate = (robot.v_right - robot.v_left) / robot.p.wheel_base;
+        for (int k = 0; k < 3; k++)
+        {
+            yaw_at[k] = i == at[k] ? yaw_rate : yaw_at[k];
+        }
+        peak = fmaxf(peak, yaw_rate);
+        if (fabsf(yaw_rate - commanded) > 0.02f * commanded)
+        {
+            settled_s = i * dt;
+        }
+    }
+    printf(
+        "  %-11s %.1f V  yaw rate %5.2f %5.2f %5.2f rad/s, peak %5.2f, "
+        "settled %4.2f s\n",
+        drive_names[drive],
+        battery_v,
+        yaw_at[0],
+        yaw_at[1],
+        yaw_at[2],
+        peak,
+        settled_s);
+}
+
+static void laps(float battery_v, Drive drive, float base_duty)
+{
+    const auto track = sim_default_track();
+    auto settings = sim_race_settings(base_duty);
+    LineFollowerState state;
+    InnerLoop loop(drive, battery_v);
+    auto r = sim_run(
+        track,
+        2,
+        60,
+        "",
+        [&](const LineEstimate& line,
+            const SimRobot& robot,
+            float dt,
+            MotorDuty* duty)
+        {
+            auto command = line_follower_step(settings, &state, line, dt);
+            *duty = loop.step(command, robot, dt);
+            return true;
+        },
+        SIM_LAPS,
+        battery_params(battery_v));
+    printf(
+        "  %-11s %.1f V  duty %.2f: %d laps %5.2f s (off track %d, max err "
+        "%4.1f mm)\n",
+        drive_names[drive],
+        battery_v,
+        base_duty,
+        SIM_LAPS,
+        r.finish_time_s,
+        r.off_track,
+        r.max_abs_error * 1000);
+}
+
+int main()
+{
+    printf(
+        "turn command %.2f rad/s, after 0.1 0.25 0.5 s:\n",
+        0.1f * 2 * LF_WHEEL_SPEED_MAX / LF_WHEEL_BASE_M);
+    for (Drive drive : {OPEN_LOOP, COMPENSATED, INNER_LOOP})
+    {
+        for (float battery_v : batteries)
+        {
+            turn_rate(battery_v, drive);
+        }
+    }
+    printf("laps, steering tuned at nominal voltage:\n");
+    for (Drive drive : {OPEN_LOOP, COMPENSATED, INNER_LOOP})
+    {
+        for (float battery_v : batteries)
+        {
+            laps(battery_v, drive, 0.22f);
+        }
+    }
+    return 0;
+}
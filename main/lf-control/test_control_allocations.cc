@@ -0,0 +1,169 @@
+// g++ test_control_allocations.cc ../i2c_bus/i2c_transaction.cc line_estimator.cc line_follower.cc motion_estimator.cc pid.cc wheel_speed.cc ../motors/motor_lut.cc -I../i2c_bus/host -o test_control_allocations.e -std=c++17 -O2 -s && ./test_control_allocations.e
+/**
+ * Host count of heap allocations in one control cycle: sensor bus
+ * transactions of i2c_transaction.h on a stand-in of the IDF command link
+ * API, then estimators, line follower, wheel speed loop and motor table. The
+ * old drivers built every transaction with i2c_cmd_link_create(). The bus
+ * arbiter around the transactions (i2c_bus.h) only takes a static mutex.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../i2c_bus/i2c_transaction.h"
+#include "../motors/motor_lut.h"
+#include "line_estimator.h"
+#include "line_follower.h"
+#include "motion_estimator.h"
+#include "wheel_speed.h"
+
+using namespace std;
+using bench_clock = chrono::steady_clock;
+
+static uint64_t allocations = 0;
+static uint32_t bus_errors = 0;  // command link too small
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* operator new(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+/* Transactions of one sensor frame and a camera packet, as the drivers */
+constexpr uint8_t ads7138_address = 0x11, mpu6500_address = 0x68, cam_address = 0x54;
+constexpr uint8_t ads7138_read_prefix[] = {0x30, 0x1a};  // READ_CONTINOUS, RECENT_CH0_LSB
+constexpr uint8_t mpu6500_read_prefix[] = {0x3b};        // ACCEL_XOUT_H
+
+struct Frame
+{
+    uint16_t line[LINE_SENSORS];
+    uint16_t imu[7];
+    uint8_t cam[64];
+};
+
+static void read_frame(Frame* frame)
+{
+    bus_errors += i2c_transaction_read(I2C_NUM_1, ads7138_address, ads7138_read_prefix, 2, (uint8_t*)frame->line,
+                                       sizeof(frame->line), 100) != ESP_OK;
+    bus_errors += i2c_transaction_read(I2C_NUM_1, mpu6500_address, mpu6500_read_prefix, 1, (uint8_t*)frame->imu,
+                                       sizeof(frame->imu), 100) != ESP_OK;
+    bus_errors += i2c_transaction_read(I2C_NUM_0, cam_address, NULL, 0, frame->cam, sizeof(frame->cam), 1000) != ESP_OK;
+}
+
+/* Register read as the drivers did it before i2c_transaction.h */
+static void legacy_read(uint8_t address, const uint8_t* prefix, uint32_t prefix_length, uint8_t* data, uint32_t length)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (prefix_length)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, true);
+        for (uint32_t k = 0; k < prefix_length; k++)
+        {
+            i2c_master_write_byte(cmd, prefix[k], true);
+        }
+    }
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, data, length, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    i2c_master_cmd_begin(I2C_NUM_1, cmd, 100);
+    i2c_cmd_link_delete(cmd);
+}
+
+static void legacy_read_frame(Frame* frame)
+{
+    legacy_read(ads7138_address, ads7138_read_prefix, 2, (uint8_t*)frame->line, sizeof(frame->line));
+    legacy_read(mpu6500_address, mpu6500_read_prefix, 1, (uint8_t*)frame->imu, sizeof(frame->imu));
+    legacy_read(cam_address, NULL, 0, frame->cam, sizeof(frame->cam));
+}
+
+struct Control
+{
+    LineEstimator estimator;
+    LineEstimate line;
+    LineFollowerSettings settings;
+    LineFollowerState state;
+    MotionEstimator motion;
+    WheelSpeedController wheel_speed;
+    MotorLut lut = {};
+
+    Control()
+    {
+        line_estimator_init(&estimator);
+        motion_estimator_init(&motion);
+        wheel_speed_init(&wheel_speed);
+    }
+
+    /* Stages after read_sensors, as control.cc */
+    float step(const Frame& frame, float dt)
+    {
+        line_estimate(&estimator, frame.line, &line);
+        motion_estimate(&motion, frame.imu[4] * 1e-4f, frame.imu[0] * 1e-4f, 0.5f, 0, dt);
+        auto duty = line_follower_step(settings, &state, line, dt);
+        float setpoint[WHEELS], measured[WHEELS];
+        motor_duty_wheel_speeds(duty, setpoint);
+        wheel_speeds_from_motion(motion.estimate.velocity, motion.estimate.yaw_rate, measured);
+        duty = wheel_speed_step(&wheel_speed, setpoint, measured, dt);
+        return motor_lut_duty(lut, 0, duty.left, 7.4f) + motor_lut_duty(lut, 1, duty.right, 7.4f);
+    }
+};
+
+/* Allocations of count cycles after the first one */
+template <typename Read>
+static uint64_t cycles(const char* name, Read read)
+{
+    constexpr uint32_t count = 100000;
+    Control control;
+    Frame frame;
+    float check = 0;
+    read(&frame);
+    control.step(frame, 0.001f);  // first cycle may initialize
+    uint64_t before = allocations;
+    auto start = bench_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        read(&frame);
+        check += control.step(frame, 0.001f);
+    }
+    chrono::duration<double, nano> total = bench_clock::now() - start;
+    uint64_t made = allocations - before;
+    printf(
+        "%-14s %5.2f allocations/cycle, %6.1f ns/cycle (%g)\n",
+        name,
+        double(made) / count,
+        total.count() / count,
+        check);
+    return made;
+}
+
+int main()
+{
+    cycles("cmd_link", legacy_read_frame);
+    bool failed = cycles("transaction", read_frame) != 0;
+    if (bus_errors)
+    {
+        printf("%u transactions did not fit I2C_TRANSACTION_LINK_SIZE\n", bus_errors);
+    }
+    return failed || bus_errors;
+}
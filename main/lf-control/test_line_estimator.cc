@@ -0,0 +1,136 @@
+// g++ test_line_estimator.cc line_estimator.cc -o test_line_estimator.e -std=c++17 -O2 -s && ./test_line_estimator.e
+/* Host benchmark and accuracy check of the line estimator */
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "line_estimator.h"
+
+using namespace std;
+using bench_clock = chrono::steady_clock;
+
+/* Raw readings of line at position (in sensor pitches), gaussian spot */
+static void simulate(
+    float position,
+    float width,
+    float noise,
+    mt19937& rng,
+    uint16_t raw[LINE_SENSORS])
+{
+    normal_distribution<float> n(0, noise);
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        float x = float(k) - LINE_POSITION_MAX - position;
+        float v = 0.1f + 0.8f * expf(-x * x / (2 * width * width)) + n(rng);
+        // channels differ in sensitivity, calibration removes it
+        v *= 0.8f + 0.05f * k;
+        raw[k] = uint16_t(clamp(v, 0.f, 1.f) * UINT16_MAX);
+    }
+}
+
+static void accuracy(const char* name, LineEstimatorMode mode, float width)
+{
+    mt19937 rng(1);
+    LineEstimator estimator;
+    line_estimator_init(&estimator);
+    uint16_t background[LINE_SENSORS], line[LINE_SENSORS];
+    for (uint32_t k = 0; k < LINE_SENSORS; k++)
+    {
+        background[k] = uint16_t(0.1f * (0.8f + 0.05f * k) * UINT16_MAX);
+        line[k] = uint16_t(0.9f * (0.8f + 0.05f * k) * UINT16_MAX);
+    }
+    line_estimator_calibrate(&estimator, background, line);
+    estimator.mode = mode;
+
+    float max_err = 0, sum_err = 0;
+    uint32_t count = 0;
+    for (float p = -3.f; p <= 3.f; p += 0.01f)
+    {
+        uint16_t raw[LINE_SENSORS];
+        simulate(p, width, 0.01f, rng, raw);
+        LineEstimate e;
+        line_estimate(&estimator, raw, &e);
+        float err = fabsf(e.position - p);
+        max_err = max(max_err, err);
+        sum_err += err;
+        count++;
+    }
+    printf(
+        "%-28s width %.1f  mean err %.3f max err %.3f pitch\n",
+        name,
+        width,
+        sum_err / count,
+        max_err);
+}
+
+static void speed(const char* name, LineEstimatorMode mode)
+{
+    mt19937 rng(2);
+    constexpr uint32_t frames = 1024, count = 2000000;
+    vector<uint16_t> raw(frames * LINE_SENSORS);
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        simulate(
+            6.f * i / frames - 3.f, 0.7f, 0.02f, rng, &raw[i * LINE_SENSORS]);
+    }
+    LineEstimator estimator;
+    line_estimator_init(&estimator);
+    estimator.mode = mode;
+
+    LineEstimate e;
+    float check = 0;
+    auto start = bench_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        line_estimate(
+            &estimator, &raw[(i % frames) * LINE_SENSORS], &e);
+        check += e.position;
+    }
+    chrono::duration<double, nano> total = bench_clock::now() - start;
+    printf(
+        "%-28s %6.1f ns/estimate (%g)\n", name, total.count() / count, check);
+}
+
+int main()
+{
+    for (float width : {0.4f, 0.7f, 1.5f})
+    {
+        accuracy("centroid", LINE_CENTROID, width);
+        accuracy("parabolic", LINE_PARABOLIC, width);
+    }
+    speed("centroid", LINE_CENTROID);
+    speed("parabolic", LINE_PARABOLIC);
+
+    // line lost keeps last side
+    LineEstimator estimator;
+    line_estimator_init(&estimator);
+    uint16_t raw[LINE_SENSORS] = {0, 0, 0, 0, 0, 0, 0, 60000};
+    LineEstimate e;
+    line_estimate(&estimator, raw, &e);
+    fill(raw, raw + LINE_SENSORS, 1000);
+    line_estimate(&estimator, raw, &e);
+    printf(
+        "%-28s lost %d position %.2f\n", "line lost", e.line_lost, e.position);
+
+    // centered line lost (and lost at start) gives no side to steer to
+    line_estimator_init(&estimator);
+    line_estimate(&estimator, raw, &e);
+    float at_start = e.position;
+    mt19937 rng(3);
+    simulate(0.1f, 0.7f, 0, rng, raw);
+    line_estimate(&estimator, raw, &e);
+    fill(raw, raw + LINE_SENSORS, 1000);
+    line_estimate(&estimator, raw, &e);
+    printf(
+        "%-28s lost %d position %.2f, at start %.2f\n",
+        "line lost centered",
+        e.line_lost,
+        e.position,
+        at_start);
+    return !(e.line_lost && e.position == 0 && at_start == 0);
+}
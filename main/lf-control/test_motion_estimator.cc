@@ -0,0 +1,152 @@
+// g++ test_motion_estimator.cc motion_estimator.cc -o test_motion_estimator.e -std=c++17 -O2 -s && ./test_motion_estimator.e
+/* Host accuracy check and benchmark of the gyro + odometry fusion */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+#include "motion_estimator.h"
+
+using namespace std;
+using bench_clock = chrono::steady_clock;
+
+#define RATE_HZ 1000
+/* Bounds of the check, with biased and noisy sensors */
+#define MAX_HEADING_ERR 0.01f        // [rad]
+#define MAX_MEAN_VELOCITY_ERR 0.01f  // [m/s]
+/* as5055 on 25 mm wheel, 4096 counts per turn */
+#define ENCODER_STEP_M (2 * 3.141592f * 0.0125f / 4096)
+
+/* Robot motion, true values */
+struct Truth
+{
+    float velocity;
+    float yaw_rate;
+    float accel;
+    float wheel_spin;  // odometry speed above velocity [m/s]
+};
+
+/* Stand, accelerate, curve, brake with wheels locked, stand */
+static Truth scenario(float t)
+{
+    Truth s = {0, 0, 0, 0};
+    if (t < 2)
+    {
+        return s;
+    }
+    t -= 2;
+    if (t < 0.5f)
+    {
+        s.velocity = 3 * t;
+        s.accel = 3;
+        return s;
+    }
+    s.velocity = 1.5f;
+    t -= 0.5f;
+    if (t < 2)
+    {
+        s.yaw_rate = 1.5f * 2.f * sinf(3.141592f * t);  // 2 1/m peak
+        return s;
+    }
+    t -= 2;
+    if (t < 0.5f)
+    {
+        s.velocity = 1.5f - 3 * t;
+        s.accel = -3;
+        s.wheel_spin = t < 0.2f ? -s.velocity : 0;  // locked wheels
+        return s;
+    }
+    s.velocity = 0;
+    return s;
+}
+
+/* false if errors exceed the bounds, slip is missed or falsely detected */
+static bool accuracy(float gyro_bias, float accel_bias)
+{
+    mt19937 rng(1);
+    normal_distribution<float> gyro_noise(0, 0.02f), accel_noise(0, 0.3f);
+    MotionEstimator estimator;
+    motion_estimator_init(&estimator);
+
+    const float dt = 1.f / RATE_HZ;
+    float heading = 0, distance = 0, odometry_distance = 0;
+    int64_t last_count = 0;
+    float max_heading_err = 0, sum_velocity_err = 0, max_velocity_err = 0;
+    uint32_t samples = 0, slip_cycles = 0, false_slip = 0;
+    for (uint32_t i = 0; i < 7 * RATE_HZ; i++)
+    {
+        auto s = scenario(i * dt);
+        heading += s.yaw_rate * dt;
+        distance += s.velocity * dt;
+        odometry_distance += (s.velocity + s.wheel_spin) * dt;
+        int64_t count = llroundf(odometry_distance / ENCODER_STEP_M);
+        float odometry_speed = (count - last_count) * ENCODER_STEP_M / dt;
+        last_count = count;
+        float curvature = s.velocity > 0.01f ? s.yaw_rate / s.velocity : 0;
+
+        motion_estimate(
+            &estimator,
+            s.yaw_rate + gyro_bias + gyro_noise(rng),
+            s.accel + accel_bias + accel_noise(rng),
+            odometry_speed,
+            curvature,
+            dt);
+        auto& e = estimator.estimate;
+        if (i * dt > 2)
+        {  // after bias learning
+            max_heading_err = max(max_heading_err, fabsf(e.heading - heading));
+            float err = fabsf(e.velocity - s.velocity);
+            sum_velocity_err += err;
+            max_velocity_err = max(max_velocity_err, err);
+            samples++;
+        }
+        slip_cycles += e.sliding && s.wheel_spin;
+        false_slip += e.sliding && !s.wheel_spin;
+    }
+    printf(
+        "bias %5.2f rad/s %4.1f m/s^2  heading err %.3f rad  velocity err "
+        "mean %.3f max %.3f m/s  slip %u ms, false %u ms\n",
+        gyro_bias,
+        accel_bias,
+        max_heading_err,
+        sum_velocity_err / samples,
+        max_velocity_err,
+        slip_cycles,
+        false_slip);
+    bool ok = max_heading_err < MAX_HEADING_ERR
+              && sum_velocity_err / samples < MAX_MEAN_VELOCITY_ERR
+              && slip_cycles && !false_slip;
+    if (!ok)
+    {
+        printf("  out of bounds\n");
+    }
+    return ok;
+}
+
+static void speed()
+{
+    constexpr uint32_t count = 10000000;
+    MotionEstimator estimator;
+    motion_estimator_init(&estimator);
+    float check = 0;
+    auto start = bench_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float x = float(i & 1023) * (1.f / 1024);
+        motion_estimate(&estimator, x, 1 - x, 1.5f * x, 0.5f, 0.001f);
+        check += estimator.estimate.heading;
+    }
+    chrono::duration<double, nano> total = bench_clock::now() - start;
+    printf("%6.1f ns/estimate (%g)\n", total.count() / count, check);
+}
+
+int main()
+{
+    bool ok = accuracy(0, 0);
+    ok &= accuracy(0.05f, 0.5f);
+    ok &= accuracy(-0.1f, -1.f);
+    speed();
+    return !ok;
+}
@@ -0,0 +1,278 @@
+/* Track map learned on a slow lap and speed profile for the next ones */
+#include "track_map.h"
+
+#include <cmath>
+#include <cstdio>
+
+/* Segment ends when curvature differs from its mean more than this */
+#define TRACK_MAP_CURVATURE_TOLERANCE 0.8f  // [1/m]
+#define TRACK_MAP_CURVATURE_RELATIVE 0.2f
+#define TRACK_MAP_MIN_SEGMENT_M 0.03f
+/* Curvature smoothing window, bins on each side */
+#define TRACK_MAP_SMOOTH_BINS 3
+/* Curve entry used for distance sync */
+#define TRACK_MAP_SYNC_CURVATURE 1.5f  // [1/m]
+#define TRACK_MAP_SYNC_WINDOW 0.2f     // [m]
+#define TRACK_MAP_SYNC_STRAIGHT 0.2f   // [m] before the curve
+#define TRACK_MAP_SYNC_FILTER_S 0.01f
+
+void track_map_record_start(TrackMapRecorder* recorder)
+{
+    for (uint32_t k = 0; k < TRACK_MAP_MAX_BINS; k++)
+    {
+        recorder->curvature_sum[k] = 0;
+        recorder->count[k] = 0;
+    }
+    recorder->bins = 0;
+}
+
+/* Add one control cycle of the learning lap, bins beyond the buffer drop */
+void track_map_record(
+    TrackMapRecorder* recorder, float distance, float curvature)
+{
+    int32_t bin = distance / TRACK_MAP_BIN_M;
+    if (bin < 0 || bin >= TRACK_MAP_MAX_BINS)
+    {
+        return;
+    }
+    recorder->curvature_sum[bin] += curvature;
+    recorder->count[bin]++;
+    recorder->bins = recorder->bins > uint32_t(bin + 1) ? recorder->bins
+                                                        : uint32_t(bin + 1);
+}
+
+static float bin_curvature(const TrackMapRecorder& recorder, int32_t bin)
+{
+    // lap is closed, window wraps around
+    float sum = 0;
+    uint32_t count = 0;
+    for (int32_t k = bin - TRACK_MAP_SMOOTH_BINS;
+         k <= bin + TRACK_MAP_SMOOTH_BINS;
+         k++)
+    {
+        uint32_t i = (k + recorder.bins) % recorder.bins;
+        sum += recorder.curvature_sum[i];
+        count += recorder.count[i];
+    }
+    return count ? sum / count : 0;
+}
+
+/* Empty map in place, TrackMap temporary would be 3 KB on the httpd stack */
+static void track_map_clear(TrackMap* map, const SpeedProfileSettings& profile)
+{
+    map->magic = TRACK_MAP_MAGIC;
+    map->version = TRACK_MAP_VERSION;
+    map->segments = 0;
+    map->length = 0;
+    map->profile = profile;
+}
+
+/**
+ * @brief Split recorded lap into segments of similar curvature and plan
+ * speed profile on them
+ *
+ * @return false if nothing was recorded
+ */
+bool track_map_build(
+    const TrackMapRecorder& recorder,
+    const SpeedProfileSettings& profile,
+    TrackMap* map)
+{
+    track_map_clear(map, profile);
+    if (recorder.bins < 2)
+    {
+        return false;
+    }
+    map->length = recorder.bins * TRACK_MAP_BIN_M;
+
+    uint32_t start = 0;
+    float sum = 0, peak = 0;
+    for (uint32_t bin = 0; bin <= recorder.bins; bin++)
+    {
+        float c = bin < recorder.bins ? bin_curvature(recorder, bin) : 0;
+        uint32_t length = bin - start;
+        float mean = length ? sum / length : c;
+        float tolerance = TRACK_MAP_CURVATURE_TOLERANCE
+                          + TRACK_MAP_CURVATURE_RELATIVE * fabsf(mean);
+        bool split = fabsf(c - mean) > tolerance
+                     && length * TRACK_MAP_BIN_M >= TRACK_MAP_MIN_SEGMENT_M;
+        bool last_free = map->segments < TRACK_MAP_MAX_SEGMENTS - 1;
+        if (bin == recorder.bins || (split && last_free))
+        {
+            auto& s = map->segment[map->segments++];
+            s.start = start * TRACK_MAP_BIN_M;
+            s.length = length * TRACK_MAP_BIN_M;
+            s.curvature = mean;
+            s.peak = peak;
+            start = bin;
+            sum = 0;
+            peak = 0;
+        }
+        sum += c;
+        peak = fmaxf(peak, fabsf(c));
+    }
+    track_map_plan(map);
+    return true;
+}
+
+/**
+ * @brief Speed limit of every segment from lateral acceleration, then
+ * backward (brake) and forward (accelerate) passes. Lap is closed, so
+ * passes go around twice.
+ */
+void track_map_plan(TrackMap* map)
+{
+    auto& p = map->profile;
+    uint32_t n = map->segments;
+    if (!n)
+    {
+        return;
+    }
+    for (uint32_t k = 0; k < n; k++)
+    {
+        auto& s = map->segment[k];
+        float v = s.peak > 1e-3f ? sqrtf(p.lateral_accel / s.peak) : p.v_max;
+        s.v_limit = fminf(fmaxf(v, p.v_min), p.v_max);
+        s.v_entry = s.v_limit;
+    }
+    // speed at the end of segment k is entry speed of segment k + 1
+    for (uint32_t pass = 0; pass < 2 * n; pass++)
+    {
+        uint32_t k = (2 * n - 1 - pass) % n;
+        auto& s = map->segment[k];
+        float v_exit = map->segment[(k + 1) % n].v_entry;
+        float v_brake = sqrtf(v_exit * v_exit + 2 * p.brake * s.length);
+        s.v_entry = fminf(s.v_entry, fminf(v_brake, s.v_limit));
+    }
+    for (uint32_t pass = 0; pass < 2 * n; pass++)
+    {
+        uint32_t k = pass % n;
+        auto& s = map->segment[k];
+        auto& next = map->segment[(k + 1) % n];
+        float v_accel = sqrtf(s.v_entry * s.v_entry + 2 * p.accel * s.length);
+        next.v_entry = fminf(next.v_entry, fminf(v_accel, next.v_limit));
+    }
+}
+
+/**
+ * @brief Planned speed at distance from the lap start, fixed cost
+ *
+ * @param hint segment of the previous call, updated
+ */
+float track_map_speed(const TrackMap& map, float distance, uint32_t* hint)
+{
+    if (!map.segments || map.length <= 0)
+    {
+        return map.profile.v_min;
+    }
+    float s_lap = fmodf(distance, map.length);
+    s_lap += s_lap < 0 ? map.length : 0;
+    uint32_t k = *hint < map.segments ? *hint : 0;
+    // few steps at most, segments are longer than one control cycle
+    for (uint32_t i = 0; i < map.segments; i++)
+    {
+        auto& s = map.segment[k];
+        if (s_lap >= s.start && s_lap < s.start + s.length)
+        {
+            break;
+        }
+        k = (k + 1) % map.segments;
+    }
+    *hint = k;
+
+    auto& s = map.segment[k];
+    auto& next = map.segment[(k + 1) % map.segments];
+    float from_start = s_lap - s.start;
+    float to_end = s.start + s.length - s_lap;
+    auto& p = map.profile;
+    float v_accel = sqrtf(s.v_entry * s.v_entry + 2 * p.accel * from_start);
+    float v_brake = sqrtf(next.v_entry * next.v_entry + 2 * p.brake * to_end);
+    return fminf(s.v_limit, fminf(v_accel, v_brake));
+}
+
+/**
+ * @brief Planned speed for race lap, called every control cycle
+ *
+ * @param distance odometry from the lap start [m]
+ * @param curvature driven now, from duties or gyro [1/m]
+ */
+float track_map_follow(
+    const TrackMap& map,
+    TrackMapFollower* follower,
+    float distance,
+    float curvature,
+    float dt)
+{
+    follower->curvature += (curvature - follower->curvature) * dt
+                           / (TRACK_MAP_SYNC_FILTER_S + dt);
+    float c = fabsf(follower->curvature);
+    // hysteresis, the controller ripple must not look like a new curve
+    bool in_curve = follower->in_curve ? c > TRACK_MAP_SYNC_CURVATURE / 2
+                                       : c > TRACK_MAP_SYNC_CURVATURE;
+    if (!in_curve && follower->in_curve)
+    {
+        follower->straight_start = distance;
+    }
+    if (in_curve && !follower->in_curve && map.segments > 1
+        && distance - follower->straight_start >= TRACK_MAP_SYNC_STRAIGHT)
+    {
+        // nearest curve entry on the map
+        float s_lap = fmodf(distance + follower->offset, map.length);
+        float best = TRACK_MAP_SYNC_WINDOW;
+        for (uint32_t k = 0; k < map.segments; k++)
+        {
+            auto& prev = map.segment[(k + map.segments - 1) % map.segments];
+            auto& s = map.segment[k];
+            if (s.peak <= TRACK_MAP_SYNC_CURVATURE
+                || prev.peak > TRACK_MAP_SYNC_CURVATURE
+                || prev.length < TRACK_MAP_SYNC_STRAIGHT)
+            {
+                continue;
+            }
+            float d = s.start - s_lap;
+            d -= d > map.length / 2 ? map.length : 0;
+            d += d < -map.length / 2 ? map.length : 0;
+            if (fabsf(d) < fabsf(best))
+            {
+                best = d;
+            }
+        }
+        if (fabsf(best) < TRACK_MAP_SYNC_WINDOW)
+        {
+            follower->offset += best;
+            follower->syncs++;
+        }
+    }
+    follower->in_curve = in_curve;
+    return track_map_speed(map, distance + follower->offset, &follower->hint);
+}
+
+bool track_map_save(const TrackMap& map, const char* fname)
+{
+    auto F = fopen(fname, "wb");
+    if (!F)
+    {
+        return false;
+    }
+    bool ok = fwrite(&map, sizeof(map), 1, F) == 1;
+    return fclose(F) == 0 && ok;
+}
+
+bool track_map_load(TrackMap* map, const char* fname)
+{
+    auto F = fopen(fname, "rb");
+    if (!F)
+    {
+        return false;
+    }
+    bool ok = fread(map, sizeof(*map), 1, F) == 1;
+    fclose(F);
+    ok = ok && map->magic == TRACK_MAP_MAGIC
+         && map->version == TRACK_MAP_VERSION
+         && map->segments <= TRACK_MAP_MAX_SEGMENTS;
+    if (!ok)
+    {
+        track_map_clear(map, SpeedProfileSettings());
+    }
+    return ok;
+}
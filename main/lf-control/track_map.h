@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+/* Curvature recorded on learning lap every TRACK_MAP_BIN_M */
+#define TRACK_MAP_BIN_M 0.01f
+#define TRACK_MAP_MAX_BINS 4096
+#define TRACK_MAP_MAX_SEGMENTS 128
+
+#define TRACK_MAP_MAGIC 0x50414d54  // "TMAP"
+#define TRACK_MAP_VERSION 1
+
+/* Map learning - curvature against travelled distance */
+struct TrackMapRecorder
+{
+    float curvature_sum[TRACK_MAP_MAX_BINS];
+    uint16_t count[TRACK_MAP_MAX_BINS];
+    uint32_t bins = 0;
+};
+
+struct TrackMapSegment
+{
+    float start;      // distance from lap start [m]
+    float length;     // [m]
+    float curvature;  // mean [1/m], positive - left
+    float peak;       // largest |curvature| in segment, limits speed [1/m]
+    float v_limit;    // from lateral acceleration [m/s]
+    float v_entry;    // planned speed at start, after accel/brake passes
+};
+
+struct SpeedProfileSettings
+{
+    float lateral_accel = 7;  // [m/s^2]
+    float accel = 6;          // [m/s^2]
+    float brake = 4;          // [m/s^2] motors, lower than grip
+    float v_max = 2.5f;       // [m/s]
+    float v_min = 0.5f;       // [m/s]
+};
+
+/* Stored on SD card as raw bytes, 32 bit fields only */
+struct TrackMap
+{
+    uint32_t magic = TRACK_MAP_MAGIC;
+    uint32_t version = TRACK_MAP_VERSION;
+    uint32_t segments = 0;
+    float length = 0;  // lap [m]
+    SpeedProfileSettings profile;
+    TrackMapSegment segment[TRACK_MAP_MAX_SEGMENTS];
+};
+
+/**
+ * @brief Position on the map during race laps. Odometry drifts and the path
+ * differs from the learning lap, so distance is snapped to the start of
+ * every curve when the robot enters it.
+ */
+struct TrackMapFollower
+{
+    float offset = 0;     // added to odometry distance
+    float curvature = 0;  // filtered
+    bool in_curve = false;
+    float straight_start = 0;  // odometry distance of the last curve exit
+    uint32_t hint = 0;
+    uint32_t syncs = 0;
+};
+
+void track_map_record_start(TrackMapRecorder* recorder);
+void track_map_record(
+    TrackMapRecorder* recorder, float distance, float curvature);
+bool track_map_build(
+    const TrackMapRecorder& recorder,
+    const SpeedProfileSettings& profile,
+    TrackMap* map);
+void track_map_plan(TrackMap* map);
+float track_map_speed(const TrackMap& map, float distance, uint32_t* hint);
+float track_map_follow(
+    const TrackMap& map,
+    TrackMapFollower* follower,
+    float distance,
+    float curvature,
+    float dt);
+bool track_map_save(const TrackMap& map, const char* fname);
+bool track_map_load(TrackMap* map, const char* fname);
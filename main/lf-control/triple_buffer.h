@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Wait-free exchange of the latest value between two tasks.
+ * Writer fills back buffer and publishes it, reader takes the newest
+ * published one. Nobody waits and no frame is ever read while written.
+ */
+template <class T>
+class TripleBuffer
+{
+    static constexpr uint8_t FRESH = 4;  // middle buffer not read yet
+
+    T buffers[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t back = 0;   // only writer
+    uint8_t front = 2;  // only reader
+
+   public:
+    T& back_buffer() { return buffers[back]; }
+
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & 3;
+    }
+
+    /** Switch to newest published value, false if there is no new one */
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+        {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T& front_buffer() { return buffers[front]; }
+};
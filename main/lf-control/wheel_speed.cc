@@ -0,0 +1,46 @@
+#include "wheel_speed.h"
+
+/* Gains and motor model of the simulator, see sim/wheel_speed_sim.cc */
+void wheel_speed_init(WheelSpeedController* controller) {
+    auto& pid = controller->settings.pid;
+    pid = PID_bank_settings_t<WHEELS>();
+    for (uint32_t c = 0; c < WHEELS; c++) {
+        pid.kp[0][c] = 0.1f;
+        pid.ki[0][c] = 1.f;
+        pid.kff[0][c] = 0.5f / LF_WHEEL_SPEED_MAX;
+        pid.kaw[c] = pid.ki[0][c] / pid.kp[0][c];
+        pid.tf[c] = 0.002f;
+        pid.out_min[c] = LF_DUTY_MIN - LF_DUTY_STOP;
+        pid.out_max[c] = LF_DUTY_MAX - LF_DUTY_STOP;
+    }
+    controller->settings.motor_tau = 0.04f;
+    controller->settings.accel_max = 9.f;
+    wheel_speed_reset(controller);
+}
+
+/* Integral cleared, reference starts at the next measured speed */
+void wheel_speed_reset(WheelSpeedController* controller) {
+    pid_bank_reset(&controller->state);
+}
+
+/**
+ * @brief Duties driving the wheels at setpoint speeds
+ *
+ * @param setpoint [m/s]
+ * @param measured [m/s]
+ */
+MotorDuty wheel_speed_step(WheelSpeedController* controller, const float setpoint[WHEELS],
+                           const float measured[WHEELS], float dt) {
+    auto& reference = controller->reference;
+    auto& s = controller->settings;
+    const float k = dt / (s.motor_tau + dt);
+    for (uint32_t c = 0; c < WHEELS; c++) {
+        float dv = clamp((setpoint[c] - reference[c]) * k, s.accel_max * dt);
+        reference[c] = controller->state.first ? measured[c] : reference[c] + dv;
+    }
+    auto out = pid_bank_step(s.pid, &controller->state, reference, measured, setpoint, 0.f, dt);
+    return {
+        .left = LF_DUTY_STOP + out[WHEEL_LEFT],
+        .right = LF_DUTY_STOP + out[WHEEL_RIGHT],
+    };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+#include "line_follower.h"
+#include "pid.h"
+
+enum WheelSide {
+    WHEEL_LEFT,
+    WHEEL_RIGHT,
+    WHEELS
+};
+
+/**
+ * @brief Inner loop of every wheel: speed [m/s] -> duty offset from
+ * LF_DUTY_STOP. Feedforward is the duty of the motor model, the motors
+ * module makes duty linear in speed at any battery voltage (motor_lut.h),
+ * PID only removes what the model misses: its setpoint is the speed the
+ * feedforward alone reaches, setpoint through first order motor lag and
+ * acceleration limit, so the integral does not wind up while wheels speed up.
+ */
+struct WheelSpeedSettings {
+    PID_bank_settings_t<WHEELS> pid;
+    float motor_tau;  // motor + robot time constant [s]
+    float accel_max;  // wheel acceleration at the grip limit [m/s^2]
+};
+
+struct WheelSpeedController {
+    WheelSpeedSettings settings;
+    PID_bank_state_t<WHEELS> state;
+    float reference[WHEELS];  // setpoint through motor model [m/s]
+};
+
+void wheel_speed_init(WheelSpeedController* controller);
+void wheel_speed_reset(WheelSpeedController* controller);
+MotorDuty wheel_speed_step(WheelSpeedController* controller, const float setpoint[WHEELS],
+                           const float measured[WHEELS], float dt);
+
+/* Wheel speed the outer loop asks for with duties, motor model inverse */
+inline void motor_duty_wheel_speeds(const MotorDuty& duty, float speed[WHEELS]) {
+    speed[WHEEL_LEFT] = 2 * (duty.left - LF_DUTY_STOP) * LF_WHEEL_SPEED_MAX;
+    speed[WHEEL_RIGHT] = 2 * (duty.right - LF_DUTY_STOP) * LF_WHEEL_SPEED_MAX;
+}
+
+/* Wheel speeds of a robot going forward and turning, no slip */
+inline void wheel_speeds_from_motion(float velocity, float yaw_rate, float speed[WHEELS]) {
+    speed[WHEEL_LEFT] = velocity - 0.5f * LF_WHEEL_BASE_M * yaw_rate;
+    speed[WHEEL_RIGHT] = velocity + 0.5f * LF_WHEEL_BASE_M * yaw_rate;
+}
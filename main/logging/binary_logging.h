@@ -1,163 +1,884 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "log_crc.h"
+#include "log_delta.h"
+#include "log_ring.h"
 
 // #define __STRINGIFY(x) #x
 #define STRINGIFY(x) __STRINGIFY(x)
 
 #define MAX_LOG_RECORD_SIZE 1024
+/* Longest JSON description of a record, schema entry has to fit in
+ * LOG_MAX_ENTRY_SIZE with declaration and stream name */
+#define MAX_LOG_JSON_DESCR_SIZE 3072
 
-#define ENABLE_TYPENAME(A) \
-    inline const char* get_typename(A v) { return #A; }
+/* SD card sector size, buffered log data is written in multiples of it */
+#define LOG_BLOCK_SIZE 512
+#define LOG_BUFFER_SIZE (LOG_BLOCK_SIZE * 8)
 
-ENABLE_TYPENAME(uint8_t)
-ENABLE_TYPENAME(int8_t)
-ENABLE_TYPENAME(uint16_t)
-ENABLE_TYPENAME(int16_t)
-ENABLE_TYPENAME(uint32_t)
-ENABLE_TYPENAME(int32_t)
-ENABLE_TYPENAME(float)
-ENABLE_TYPENAME(double)
+/* Blocks with sync word and CRC, reader skips blocks torn by power loss */
+#ifndef LOG_FRAMED_BLOCKS
+#define LOG_FRAMED_BLOCKS 1
+#endif
 
-template <class Ta>
-struct ArrayDescr
-{
-    Ta* ptr;
-    uint32_t size;
+/* Records waiting for SD writer task, ~100 ms of 1 kHz control loop data */
+#define LOG_RING_SIZE (16 * 1024)
+#define LOG_MAX_STREAMS 16
 
-    ArrayDescr(Ta* ptr, unsigned int size) : ptr(ptr), size(size) {}
+/* Delta encoded streams store full record every N records */
+#define LOG_DELTA_KEYFRAME_INTERVAL 100
+/* Memory for previous records of delta encoded streams */
+#define LOG_DELTA_STATE_SIZE 2048
 
-    auto get_size() { return sizeof(Ta) * size; }
+/* Time index entry every N records, index is written in blocks */
+#define LOG_INDEX_INTERVAL 256
+#define LOG_INDEX_BUFFER_ENTRIES (LOG_BLOCK_SIZE / sizeof(LogIndexEntry))
 
-    void write_value(void* data) { memcpy(data, (void*)ptr, get_size()); }
+/* String built at compile time, N - length without terminating zero */
+template <uint32_t N>
+struct ConstStr
+{
+    char s[N + 1] = {};
 
-    void write_json_descr(FILE* F)
+    constexpr ConstStr() = default;
+    constexpr ConstStr(const char (&str)[N + 1])
     {
-        fprintf(
-            F,
-            "{\"type\": \"%s\", \"count\": \"%u\"}",
-            get_typename(*(Ta*)-1),
-            size);
+        for (uint32_t i = 0; i < N; i++)
+        {
+            s[i] = str[i];
+        }
     }
+
+    constexpr uint32_t size() const { return N; }
+    constexpr const char* c_str() const { return s; }
 };
 
-template <class T>
-struct ValueDescr
+template <uint32_t N>
+ConstStr(const char (&str)[N]) -> ConstStr<N - 1>;
+
+template <uint32_t N1, uint32_t N2>
+constexpr auto operator+(const ConstStr<N1>& a, const ConstStr<N2>& b)
 {
-    T v;
-    ValueDescr(T v) : v(v) {}
+    ConstStr<N1 + N2> r;
+    for (uint32_t i = 0; i < N1; i++)
+    {
+        r.s[i] = a.s[i];
+    }
+    for (uint32_t i = 0; i < N2; i++)
+    {
+        r.s[N1 + i] = b.s[i];
+    }
+    return r;
+}
 
-    auto get_size() { return sizeof(T); }
+template <uint32_t v>
+constexpr auto const_str_num()
+{
+    constexpr char digit[2] = {char('0' + v % 10), 0};
+    if constexpr (v < 10)
+    {
+        return ConstStr(digit);
+    }
+    else
+    {
+        return const_str_num<v / 10>() + ConstStr(digit);
+    }
+}
+
+/* Name of the type in JSON description, same as used by load_logs.py */
+template <class T, class = void>
+struct LogType;
 
-    void write_value(void* data) { *((T*)data) = v; }
+#define ENABLE_TYPENAME(A)                         \
+    template <>                                    \
+    struct LogType<A>                              \
+    {                                              \
+        static constexpr auto name = ConstStr(#A); \
+    };
 
-    void write_json_descr(FILE* F)
+ENABLE_TYPENAME(float)
+ENABLE_TYPENAME(double)
+
+template <uint32_t size, bool is_signed>
+constexpr auto int_type_name()
+{
+    constexpr auto bits = const_str_num<size * 8>();
+    if constexpr (is_signed)
     {
-        fprintf(F, "{\"type\": \"%s\"}", get_typename(v));
+        return ConstStr("int") + bits + ConstStr("_t");
     }
-};
+    else
+    {
+        return ConstStr("uint") + bits + ConstStr("_t");
+    }
+}
 
+// int, long, bool... are named by size so int32_t and int work the same
 template <class T>
-inline auto get_writer(ArrayDescr<T> v)
+struct LogType<T, std::enable_if_t<std::is_integral_v<T>>>
 {
-    return v;
-}
+    static constexpr auto name =
+        int_type_name<sizeof(T), std::is_signed_v<T>>();
+};
 
+/* Single logged value */
 template <class T>
-inline auto get_writer(T v)
+struct LogField
 {
-    return ValueDescr<T>(v);
-}
+    static constexpr uint32_t size = sizeof(T);
+    static constexpr uint32_t count = 1;
+    static constexpr uint32_t element_size = sizeof(T);
+    static constexpr auto json_descr =
+        ConstStr("{\"type\": \"") + LogType<T>::name + ConstStr("\"}");
+};
+
+/* Fixed size array, e.g. ads7138_struct::ain */
+template <class T, uint32_t N>
+struct LogField<T[N]>
+{
+    static constexpr uint32_t size = sizeof(T) * N;
+    static constexpr uint32_t count = N;
+    static constexpr uint32_t element_size = sizeof(T);
+    static constexpr auto json_descr = ConstStr("{\"type\": \"")
+                                       + LogType<T>::name
+                                       + ConstStr("\", \"count\": \"")
+                                       + const_str_num<N>() + ConstStr("\"}");
+};
 
-// Create description of given parameters
-template <class Tv1, class... Targs>
-void write_json_descr_items(FILE* F, Tv1 v1, Targs... args)
+template <class Tf1, class... Tfields>
+constexpr auto join_json_descr()
 {
-    get_writer(v1).write_json_descr(F);
-    // Check amount of arguments
-    if constexpr (sizeof...(args))
+    if constexpr (sizeof...(Tfields))
+    {
+        return LogField<Tf1>::json_descr + ConstStr(",")
+               + join_json_descr<Tfields...>();
+    }
+    else
     {
-        fprintf(F, ",");
-        write_json_descr_items(F, args...);
+        return LogField<Tf1>::json_descr;
     }
 }
 
-template <class... Targs>
-void write_json_descr(
-    const char* descr_fname, const char* vnames, Targs... args)
+/* Width of every element in the record, arrays are split to elements */
+template <class... Tfields>
+constexpr auto log_record_layout()
 {
-    auto F = fopen(descr_fname, "w");
-    if (F == NULL)
+    constexpr uint32_t counts[] = {LogField<Tfields>::count...};
+    constexpr uint32_t sizes[] = {LogField<Tfields>::element_size...};
+    ConstStr<(LogField<Tfields>::count + ...)> r;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < sizeof...(Tfields); i++)
     {
-        ESP_LOGE("bSDcard: ", "Failed to open file for writing");
-        return;
+        for (uint32_t j = 0; j < counts[i]; j++)
+        {
+            r.s[n++] = sizes[i];
+        }
     }
-    fprintf(F, "{\"names\":\"%s\", \"types\":[", vnames);
-    write_json_descr_items(F, args...);
-    fprintf(F, "]}");
-    fclose(F);
+    return r;
 }
 
-// Write all data into buffor
-template <class Tv1, class... Targs>
-auto assemble_record(uint8_t* buf, Tv1 v1, Targs... args)
+/**
+ * @brief Layout of the record with given field types.
+ * Fields are packed one after another without padding.
+ */
+template <class... Tfields>
+struct LogRecord
 {
-    auto w = get_writer(v1);
-    w.write_value((void*)buf);
-    auto s = w.get_size();
-    if constexpr (sizeof...(args))
+    static constexpr uint32_t size = (LogField<Tfields>::size + ...);
+    static_assert(size <= MAX_LOG_RECORD_SIZE, "log record too big");
+
+    static constexpr auto json_types = join_json_descr<Tfields...>();
+    static constexpr auto layout = log_record_layout<Tfields...>();
+
+    /* vnames - names of the fields separated with comas */
+    template <uint32_t N>
+    static constexpr auto json_descr(const char (&vnames)[N])
+    {
+        auto descr = ConstStr("{\"names\":\"") + ConstStr<N - 1>(vnames)
+                     + ConstStr("\", \"types\":[") + json_types
+                     + ConstStr("]}");
+        static_assert(
+            sizeof(descr.s) <= MAX_LOG_JSON_DESCR_SIZE + 1,
+            "log record description too long");
+        return descr;
+    }
+
+    // Write all data into buffor, offsets are known at compile time
+    static void assemble(uint8_t* buf, const Tfields&... values)
     {
-        s += assemble_record(buf + w.get_size(), args...);
+        ((memcpy(buf, &values, LogField<Tfields>::size),
+          buf += LogField<Tfields>::size),
+         ...);
     }
-    return s;
+};
+
+/* Only for type deduction in LOG_VALUES - arrays are passed by reference */
+template <class... Targs>
+LogRecord<std::remove_cv_t<Targs>...> log_record_of(const Targs&... args);
+
+template <class... Targs>
+auto assemble_record(uint8_t* buf, const Targs&... args)
+{
+    using record_t = LogRecord<std::remove_cv_t<Targs>...>;
+    record_t::assemble(buf, args...);
+    return record_t::size;
 }
 
 template <class... Targs>
-void write_record(FILE* F, Targs... args)
+void write_record(FILE* F, const Targs&... args)
 {
     uint8_t buf[MAX_LOG_RECORD_SIZE];
     auto s = assemble_record(buf, args...);
-    // TODO: asssert s <= MAX_RECORD_SIZE
     fwrite(buf, 1, s, F);
     fflush(F);
 }
 
-// TODO: some unique/random number in file name ?
+/* Plain stdio file, used on host and when preallocation is not needed */
+class StdioLogFile
+{
+    FILE* F = NULL;
+
+   public:
+    bool is_open() { return F != NULL; }
+
+    /** mode "r+" appends to existing file, "w" creates new one */
+    bool open(const char* fname, const char* mode)
+    {
+        F = fopen(fname, mode);
+        if (!F)
+        {
+            return false;
+        }
+        // BufferedLogFile does buffering in whole blocks
+        setvbuf(F, NULL, _IONBF, 0);
+        fseek(F, 0, SEEK_END);
+        return true;
+    }
+
+    uint32_t size() { return ftell(F); }
+
+    void write(const uint8_t* data, uint32_t size) { fwrite(data, 1, size, F); }
+
+    void sync() { fflush(F); }
+
+    void close()
+    {
+        fclose(F);
+        F = NULL;
+    }
+};
 
 /**
- * @brief LOG_VALUES(zmienna1, zmienna2...) podajemy w argumencie zmienne jakie
- * chcemy zapisać do pliku Musi być stała o znanym rozmiarze podana jako
- * argument #define SD_MOUNT "/sdcard" - należy dodać int nie działa, uint32_t
- * działa NIE PRZYJMUJE INT
+ * @brief Log file kept open for the whole run.
+ * Records are collected in RAM and go to the card only in whole sectors, so
+ * FAT is updated once per few kB instead of on every record.
+ */
+template <class Tfile = StdioLogFile>
+class BufferedLogFile
+{
+    Tfile file;
+    uint32_t file_pos = 0;  // bytes already written to the file
+    uint32_t fill = 0;      // bytes waiting in buf
+    uint8_t buf[LOG_BUFFER_SIZE];
+
+    static_assert(
+        LOG_BUFFER_SIZE >= LOG_BLOCK_SIZE + MAX_LOG_RECORD_SIZE,
+        "log buffer has to fit a record after partial block");
+
+   public:
+    bool is_open() { return file.is_open(); }
+
+    /** mode "r+" appends to existing file, "w" creates new one */
+    bool open(const char* fname, const char* mode)
+    {
+        close();
+        if (!file.open(fname, mode))
+        {
+            return false;
+        }
+        file_pos = file.size();
+        fill = 0;
+        return true;
+    }
+
+    /** Get space for `size` bytes, flushes full blocks when buffer is full */
+    uint8_t* reserve(uint32_t size)
+    {
+        if (fill + size > LOG_BUFFER_SIZE)
+        {
+            flush_blocks();
+        }
+        return buf + fill;
+    }
+
+    void commit(uint32_t size) { fill += size; }
+
+    /** Offset in file of the next written byte */
+    uint32_t position() { return file_pos + fill; }
+
+    void append(const uint8_t* data, uint32_t size)
+    {
+        memcpy(reserve(size), data, size);
+        commit(size);
+    }
+
+    /** Append LOG_BLOCK_SIZE bytes, e.g. file header */
+    void append_block(const uint8_t* data) { append(data, LOG_BLOCK_SIZE); }
+
+    /** Entries are not framed, nothing to finish */
+    void end_block() {}
+
+    /** Write all data up to last sector boundary, rest stays in buffer */
+    void flush_blocks()
+    {
+        uint32_t aligned_end =
+            (file_pos + fill) / LOG_BLOCK_SIZE * LOG_BLOCK_SIZE;
+        if (aligned_end <= file_pos)
+        {
+            return;
+        }
+        uint32_t to_write = aligned_end - file_pos;
+        file.write(buf, to_write);
+        file_pos += to_write;
+        fill -= to_write;
+        memmove(buf, buf + to_write, fill);
+    }
+
+    /** Make written blocks durable, partial block stays in buffer */
+    void sync()
+    {
+        if (file.is_open())
+        {
+            flush_blocks();
+            file.sync();
+        }
+    }
+
+    /** Write everything, also partial block */
+    void flush()
+    {
+        if (file.is_open() && fill)
+        {
+            file.write(buf, fill);
+            file_pos += fill;
+            fill = 0;
+        }
+    }
+
+    void close()
+    {
+        if (file.is_open())
+        {
+            flush();
+            file.close();
+        }
+    }
+
+    ~BufferedLogFile() { close(); }
+};
+
+#define LOG_BLOCK_SYNC 0x4b4c4253  // "SBLK"
+#define LOG_BLOCK_NO_ENTRY 0xffff
+
+/**
+ * @brief Start of every block after file header in framed (version 3) file.
+ * Entries are split between blocks, first_entry lets reader start decoding
+ * in the first valid block after corrupted or missing ones (gap in seq).
  */
-#define LOG_VALUES(LOG_NAME, ...)                                              \
+struct __attribute__((packed)) LogBlockHeader
+{
+    uint32_t sync;
+    uint32_t crc;          // log_crc32 of rest of header and payload
+    uint32_t seq;          // number of block in file
+    uint16_t size;         // used payload bytes, rest is zero
+    uint16_t first_entry;  // offset in payload, LOG_BLOCK_NO_ENTRY if none
+};
+
+#define LOG_BLOCK_PAYLOAD (LOG_BLOCK_SIZE - sizeof(LogBlockHeader))
+/* Largest entry passed to reserve(), fits after partial block in buffer */
+#define LOG_MAX_ENTRY_SIZE (LOG_BUFFER_SIZE - LOG_BLOCK_SIZE)
+
+/**
+ * @brief BufferedLogFile writing entries in LogBlockHeader framed blocks.
+ * Every commit() is one entry (tag byte and its data).
+ */
+template <class Tfile>
+class FramedLogFile
+{
+    BufferedLogFile<Tfile> F;
+    uint8_t block[LOG_BLOCK_SIZE];
+    uint32_t block_fill = 0;  // payload bytes
+    uint32_t block_seq = 0;
+    uint8_t entry[LOG_MAX_ENTRY_SIZE];
+
+    LogBlockHeader& header() { return *(LogBlockHeader*)block; }
+
+   public:
+    FramedLogFile() { header().first_entry = LOG_BLOCK_NO_ENTRY; }
+
+    bool is_open() { return F.is_open(); }
+
+    bool open(const char* fname, const char* mode)
+    {
+        close();
+        block_fill = 0;
+        block_seq = 0;
+        header().first_entry = LOG_BLOCK_NO_ENTRY;
+        return F.open(fname, mode);
+    }
+
+    /** Space for one entry, at most LOG_MAX_ENTRY_SIZE, see static_assert
+     * after LogSchemaDecl */
+    uint8_t* reserve(uint32_t) { return entry; }
+
+    void commit(uint32_t size)
+    {
+        if (header().first_entry == LOG_BLOCK_NO_ENTRY)
+        {
+            header().first_entry = block_fill;
+        }
+        const uint8_t* data = entry;
+        while (size)
+        {
+            auto n = LOG_BLOCK_PAYLOAD - block_fill;
+            n = n < size ? n : size;
+            memcpy(block + sizeof(LogBlockHeader) + block_fill, data, n);
+            block_fill += n;
+            data += n;
+            size -= n;
+            if (block_fill == LOG_BLOCK_PAYLOAD)
+            {
+                end_block();
+            }
+        }
+    }
+
+    /** Offset of the block in which next entry starts */
+    uint32_t position() { return F.position(); }
+
+    void append_block(const uint8_t* data) { F.append_block(data); }
+
+    /** Unfinished block is not written, it would be framed twice */
+    void sync() { F.sync(); }
+
+    /** Write partial block, next entry starts new one */
+    void end_block()
+    {
+        if (!block_fill)
+        {
+            return;
+        }
+        auto& h = header();
+        h.sync = LOG_BLOCK_SYNC;
+        h.seq = block_seq++;
+        h.size = block_fill;
+        memset(
+            block + sizeof(LogBlockHeader) + block_fill,
+            0,
+            LOG_BLOCK_PAYLOAD - block_fill);
+        h.crc = log_crc32(
+            (const uint8_t*)&h.seq,
+            sizeof(LogBlockHeader) - offsetof(LogBlockHeader, seq)
+                + block_fill);
+        F.append_block(block);
+
+        block_fill = 0;
+        h.first_entry = LOG_BLOCK_NO_ENTRY;
+    }
+
+    void close()
+    {
+        if (F.is_open())
+        {
+            end_block();
+            F.close();
+        }
+    }
+
+    ~FramedLogFile() { close(); }
+};
+
+/* LogStreamDescr::flags */
+#define LOG_STREAM_DELTA 1
+
+/* Log stream registered by LOG_VALUES call site */
+struct LogStreamDescr
+{
+    const char* name;
+    const char* json_descr;  // constexpr string from LogRecord::json_descr
+    const char* layout;      // LogRecord::layout
+    uint32_t record_size;
+    uint32_t flags;
+};
+
+#define LOG_FILE_MAGIC "BLOG"
+#define LOG_FILE_VERSION (LOG_FRAMED_BLOCKS ? 3 : 2)
+
+/* First byte of every entry in the file after header */
+#define LOG_TAG_SCHEMA 0
+#define LOG_TAG_FIRST_STREAM 1
+/* set in tag of delta encoded record */
+#define LOG_TAG_DELTA 0x80
+
+static_assert(
+    LOG_TAG_FIRST_STREAM + LOG_MAX_STREAMS <= LOG_TAG_DELTA,
+    "stream tag has 7 bits");
+
+/**
+ * @brief Start of .blog file, zero padded up to header_size.
+ * Version 1 had one stream per file: JSON description of the record followed
+ * the header and records started at header_size.
+ * Version 2 multiplexes streams: json_descr_size and record_size are 0,
+ * after header there are entries starting with tag byte - LogSchemaDecl
+ * (LOG_TAG_SCHEMA) or record of stream declared with that tag.
+ * Streams with LOG_STREAM_DELTA have also records with tag | LOG_TAG_DELTA,
+ * one varint per element (see log_delta_encode), relative to previous record.
+ * Full record of such stream is a keyframe, decoding can start from it.
+ * Version 3 has the same entries split into LogBlockHeader framed blocks.
+ * header_size is multiple of LOG_BLOCK_SIZE so data stays sector aligned.
+ */
+struct __attribute__((packed)) LogFileHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t json_descr_size;
+    uint32_t header_size;
+    uint32_t record_size;
+    int64_t start_time_us;    // wall clock, 0 if time was never set
+    int64_t start_uptime_us;  // esp_timer time, same clock as in records
+};
+
+/* Stream description written before its first record, name and JSON follow */
+struct __attribute__((packed)) LogSchemaDecl
+{
+    uint8_t tag;  // LOG_TAG_SCHEMA
+    uint8_t stream_tag;
+    uint8_t name_size;
+    uint16_t json_descr_size;
+    uint32_t record_size;
+};
+
+static_assert(
+    sizeof(LogSchemaDecl) + UINT8_MAX + MAX_LOG_JSON_DESCR_SIZE
+        <= LOG_MAX_ENTRY_SIZE,
+    "schema entry does not fit FramedLogFile::entry");
+static_assert(
+    log_delta_max_size(MAX_LOG_RECORD_SIZE) + 1 <= LOG_MAX_ENTRY_SIZE,
+    "record entry does not fit FramedLogFile::entry");
+
+/* LogIndexEntry::flags */
+#define LOG_INDEX_SCHEMA 1
+
+/**
+ * @brief Entry of .bidx file written next to the .blog segment.
+ * Every LOG_INDEX_INTERVAL records there is an entry pointing to the record,
+ * delta streams have a keyframe right after it, so decoding can start there.
+ * Every schema declaration has also entry with LOG_INDEX_SCHEMA flag, so
+ * a reader seeking to the middle of the file can find all schemas.
+ */
+struct __attribute__((packed)) LogIndexEntry
+{
+    int64_t timestamp_us;  // esp_timer time of the record
+    uint32_t offset;       // in .blog file, block start if framed
+    uint32_t flags;
+};
+
+/**
+ * @brief Writes records of many streams to one file.
+ * Schema of each stream is put in the file right before its first record.
+ * Sparse time index goes to second file, which is written only when full
+ * block of entries is collected.
+ */
+template <class Tfile, class Tindex_file = Tfile>
+class LogWriter
+{
+    struct DeltaState
+    {
+        uint8_t* prev;  // NULL - next record is keyframe
+        uint32_t since_keyframe;
+    };
+
+#if LOG_FRAMED_BLOCKS
+    FramedLogFile<Tfile> F;
+#else
+    BufferedLogFile<Tfile> F;
+#endif
+    bool declared[LOG_MAX_STREAMS];
+    DeltaState delta[LOG_MAX_STREAMS];
+    uint8_t delta_memory[LOG_DELTA_STATE_SIZE];
+    uint32_t delta_memory_used;
+
+    Tindex_file I;  // FatFs FIL holds a sector buffer, too big for task stack
+    char index_fname[64];
+    bool index_created;
+    LogIndexEntry index[LOG_INDEX_BUFFER_ENTRIES];
+    uint32_t index_count;
+    uint32_t records_since_index;
+
+    void add_index(int64_t timestamp_us, uint32_t flags)
+    {
+        index[index_count++] = {
+            .timestamp_us = timestamp_us,
+            .offset = F.position(),
+            .flags = flags,
+        };
+        if (index_count == LOG_INDEX_BUFFER_ENTRIES)
+        {
+            flush_index();
+        }
+    }
+
+    void flush_index()
+    {
+        if (!index_count)
+        {
+            return;
+        }
+        if (I.open(index_fname, index_created ? "r+" : "w"))
+        {
+            I.write((const uint8_t*)index, index_count * sizeof(LogIndexEntry));
+            I.close();
+            index_created = true;
+        }
+        index_count = 0;
+    }
+
+    void write_header(int64_t start_time_us, int64_t start_uptime_us)
+    {
+        LogFileHeader header = {
+            .magic = {},
+            .version = LOG_FILE_VERSION,
+            .json_descr_size = 0,
+            .header_size = LOG_BLOCK_SIZE,
+            .record_size = 0,
+            .start_time_us = start_time_us,
+            .start_uptime_us = start_uptime_us,
+        };
+        memcpy(header.magic, LOG_FILE_MAGIC, sizeof(header.magic));
+        static_assert(sizeof(header) <= LOG_BLOCK_SIZE);
+
+        uint8_t block[LOG_BLOCK_SIZE] = {};
+        memcpy(block, &header, sizeof(header));
+        F.append_block(block);
+    }
+
+    void write_schema(uint16_t id, const LogStreamDescr& descr)
+    {
+        LogSchemaDecl decl = {
+            .tag = LOG_TAG_SCHEMA,
+            .stream_tag = uint8_t(LOG_TAG_FIRST_STREAM + id),
+            .name_size = uint8_t(strlen(descr.name)),
+            .json_descr_size = uint16_t(strlen(descr.json_descr)),
+            .record_size = descr.record_size,
+        };
+        auto size = sizeof(decl) + decl.name_size + decl.json_descr_size;
+        auto buf = F.reserve(size);
+        memcpy(buf, &decl, sizeof(decl));
+        memcpy(buf + sizeof(decl), descr.name, decl.name_size);
+        memcpy(
+            buf + sizeof(decl) + decl.name_size,
+            descr.json_descr,
+            decl.json_descr_size);
+        F.commit(size);
+    }
+
+    void write_raw(uint16_t id, const uint8_t* data, uint32_t size)
+    {
+        auto buf = F.reserve(size + 1);
+        buf[0] = LOG_TAG_FIRST_STREAM + id;
+        memcpy(buf + 1, data, size);
+        F.commit(size + 1);
+    }
+
+    void write_delta(
+        uint16_t id, const LogStreamDescr& descr, const uint8_t* data)
+    {
+        auto& state = delta[id];
+        auto size = descr.record_size;
+        if (!state.prev
+            || ++state.since_keyframe >= LOG_DELTA_KEYFRAME_INTERVAL)
+        {
+            if (!state.prev)
+            {
+                if (delta_memory_used + size > sizeof(delta_memory))
+                {  // no space for state, stream stays uncompressed
+                    write_raw(id, data, size);
+                    return;
+                }
+                state.prev = delta_memory + delta_memory_used;
+                delta_memory_used += size;
+            }
+            write_raw(id, data, size);
+            memcpy(state.prev, data, size);
+            state.since_keyframe = 0;
+            return;
+        }
+
+        auto buf = F.reserve(log_delta_max_size(size) + 1);
+        buf[0] = (LOG_TAG_FIRST_STREAM + id) | LOG_TAG_DELTA;
+        auto encoded_size =
+            log_delta_encode(buf + 1, data, state.prev, descr.layout);
+        F.commit(encoded_size + 1);
+        memcpy(state.prev, data, size);
+    }
+
+   public:
+    bool is_open() { return F.is_open(); }
+
+    /* Next record of every delta stream is written in full */
+    void force_keyframes()
+    {
+        for (auto& state : delta)
+        {
+            state.since_keyframe = LOG_DELTA_KEYFRAME_INTERVAL;
+        }
+    }
+
+    /** Offset in file of the next record, segment size */
+    uint32_t position() { return F.position(); }
+
+    /* index_fname - file for LogIndexEntry array, .bidx next to .blog */
+    bool open(
+        const char* fname,
+        const char* index_fname,
+        int64_t start_time_us,
+        int64_t start_uptime_us)
+    {
+        if (!F.open(fname, "w"))
+        {
+            return false;
+        }
+        memset(declared, 0, sizeof(declared));
+        memset(delta, 0, sizeof(delta));
+        delta_memory_used = 0;
+
+        snprintf(
+            this->index_fname, sizeof(this->index_fname), "%s", index_fname);
+        index_created = false;
+        index_count = 0;
+        records_since_index = 0;
+
+        write_header(start_time_us, start_uptime_us);
+        return true;
+    }
+
+    void write(
+        uint16_t id,
+        const LogStreamDescr& descr,
+        const uint8_t* data,
+        uint32_t size,
+        int64_t timestamp_us)
+    {
+        if (unlikely(!declared[id]))
+        {
+            /* in framed file schema gets own blocks, easy to send alone */
+            F.end_block();
+            add_index(timestamp_us, LOG_INDEX_SCHEMA);
+            write_schema(id, descr);
+            F.end_block();
+            declared[id] = true;
+        }
+        if (unlikely(!records_since_index--))
+        {
+            records_since_index = LOG_INDEX_INTERVAL - 1;
+            force_keyframes();
+            add_index(timestamp_us, 0);
+        }
+        if (descr.flags & LOG_STREAM_DELTA)
+        {
+            write_delta(id, descr, data);
+        }
+        else
+        {
+            write_raw(id, data, size);
+        }
+    }
+
+    /** Index and whole blocks written so far survive power loss */
+    void sync()
+    {
+        if (F.is_open())
+        {
+            flush_index();
+            F.sync();
+        }
+    }
+
+    void close()
+    {
+        if (F.is_open())
+        {
+            F.close();
+            flush_index();
+        }
+    }
+};
+
+extern LogRing<LOG_RING_SIZE> log_ring;
+extern LogStreamDescr log_streams[LOG_MAX_STREAMS];
+extern std::atomic<uint16_t> log_streams_count;
+
+/**
+ * @brief Register stream on first use of LOG_VALUES call site.
+ * Files are created later by writer task.
+ * @return stream id or LOG_RING_PAD if there are too many streams
+ */
+uint16_t log_register_stream(const LogStreamDescr& descr);
+
+/* esp_timer time, only lower 32 bits are stored in log_ring */
+int64_t log_timestamp_us();
+
+/* Put record to ring, no file access here */
+template <class Trecord, class... Targs>
+void push_record(uint16_t stream_id, const Targs&... args)
+{
+    auto buf = log_ring.reserve(stream_id, Trecord::size, log_timestamp_us());
+    if (likely(buf))
+    {
+        Trecord::assemble(buf, args...);
+        log_ring.commit();
+    }
+}
+
+#define __LOG_VALUES(LOG_NAME, FLAGS, ...)                                     \
     {                                                                          \
-        FILE* F = fopen(SD_MOUNT "/logs/" LOG_NAME ".bin", "r+");              \
-        if (likely(F))                                                         \
-        { /* File open */                                                      \
-            fseek(F, 0, SEEK_END);                                             \
-            write_record(F, __VA_ARGS__);                                      \
-            fclose(F);                                                         \
-        }                                                                      \
-        else /* File not open */                                               \
+        using log_record_t = decltype(log_record_of(__VA_ARGS__));             \
+        static constexpr auto log_json_descr =                                 \
+            log_record_t::json_descr(#__VA_ARGS__);                            \
+        static const uint16_t log_stream_id = log_register_stream({            \
+            .name = LOG_NAME,                                                  \
+            .json_descr = log_json_descr.c_str(),                              \
+            .layout = log_record_t::layout.c_str(),                            \
+            .record_size = log_record_t::size,                                 \
+            .flags = FLAGS,                                                    \
+        });                                                                    \
+        if (likely(log_stream_id != LOG_RING_PAD))                             \
         {                                                                      \
-            ESP_LOGI(                                                          \
-                "bSDCard",                                                     \
-                "Opening JSON file " SD_MOUNT "/logs/" LOG_NAME ".bin");       \
-            write_json_descr(                                                  \
-                SD_MOUNT "/logs/" LOG_NAME ".txt", #__VA_ARGS__, __VA_ARGS__); \
-            ESP_LOGI(                                                          \
-                "bSDCard", "Opening DATA " SD_MOUNT "/logs/" LOG_NAME ".txt"); \
-            F = fopen(SD_MOUNT "/logs/" LOG_NAME ".bin", "w");                 \
-            if (likely(F))                                                     \
-            {                                                                  \
-                write_record(F, __VA_ARGS__);                                  \
-                fclose(F);                                                     \
-            }                                                                  \
-            else                                                               \
-            {                                                                  \
-                ESP_LOGE("bSDcard: ", "Failed to open file for writing");      \
-            }                                                                  \
+            push_record<log_record_t>(log_stream_id, __VA_ARGS__);             \
         }                                                                      \
     }
+
+/**
+ * @brief LOG_VALUES(zmienna1, zmienna2...) podajemy w argumencie zmienne jakie
+ * chcemy zapisać do pliku. Typy i rozmiar rekordu są znane w czasie kompilacji,
+ * inty są zapisywane według rozmiaru (int -> int32_t), tablice o stałym
+ * rozmiarze (np. ads7138_struct::ain) jako pole z "count".
+ * Rekord trafia tylko do log_ring, na kartę zapisuje go SDcard_task - wolno
+ * wołać tylko z jednego taska (single producer).
+ */
+#define LOG_VALUES(LOG_NAME, ...) __LOG_VALUES(LOG_NAME, 0, __VA_ARGS__)
+
+/**
+ * @brief Jak LOG_VALUES, ale rekordy są zapisywane jako różnice do
+ * poprzedniego (varint) - dla wolno zmieniających się wartości: czas,
+ * enkodery, ADC. Co LOG_DELTA_KEYFRAME_INTERVAL rekordów zapisywany jest
+ * pełny rekord.
+ */
+#define LOG_VALUES_DELTA(LOG_NAME, ...) \
+    __LOG_VALUES(LOG_NAME, LOG_STREAM_DELTA, __VA_ARGS__)
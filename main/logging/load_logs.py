@@ -1,8 +1,27 @@
 import json
+import zlib
+from struct import calcsize, unpack_from
 from sys import argv
-from numpy import fromfile
+from numpy import dtype as numpy_dtype, frombuffer
 from pandas import DataFrame
 
+# LogFileHeader from binary_logging.h
+LOG_FILE_MAGIC = b'BLOG'
+LOG_FILE_HEADER = '<4sHHIIqq'
+# LogSchemaDecl
+LOG_SCHEMA_DECL = '<BBBHI'
+LOG_TAG_SCHEMA = 0
+LOG_TAG_DELTA = 0x80
+# LogBlockHeader of framed (version 3) files
+LOG_BLOCK_SIZE = 512
+LOG_BLOCK_HEADER = '<IIIHH'
+LOG_BLOCK_SYNC = 0x4b4c4253
+LOG_BLOCK_NO_ENTRY = 0xffff
+LOG_BLOCK_PAYLOAD = LOG_BLOCK_SIZE - calcsize(LOG_BLOCK_HEADER)
+# LogIndexEntry of .bidx file
+LOG_INDEX_ENTRY = '<qII'
+LOG_INDEX_SCHEMA = 1
+
 def dtype_from_meta(log_meta):
     types = []
     for name, type_descr in zip(log_meta['names'].split(','), log_meta['types']):
@@ -13,21 +32,224 @@ def dtype_from_meta(log_meta):
             case 'int16_t': numpy_type = '<i2'
             case 'uint32_t': numpy_type = '<u4'
             case 'int32_t': numpy_type = '<i4'
+            case 'uint64_t': numpy_type = '<u8'
+            case 'int64_t': numpy_type = '<i8'
             case 'float': numpy_type = 'f4'
             case 'double': numpy_type = 'f8'
             case _: raise NotImplementedError(f'Unknown type {type_descr["type"]}')
-        types.append((name.strip(), numpy_type))
+        if 'count' in type_descr:
+            types.append((name.strip(), numpy_type, (int(type_descr['count']),)))
+        else:
+            types.append((name.strip(), numpy_type))
     return types
 
 
-def load_log_file(fname):
-    with open(f'{fname}.json', 'r') as f:
-        descr_data = json.load(f)
-    data = fromfile(
-        f'{fname}.blog', dtype=dtype_from_meta(descr_data)
+def to_dataframe(data):
+    columns = {}
+    for name in data.dtype.names:
+        if data[name].ndim > 1:
+            for i in range(data[name].shape[1]):
+                columns[f'{name}_{i}'] = data[name][:, i]
+        else:
+            columns[name] = data[name]
+    return DataFrame(columns)
+
+
+def read_log_header(raw):
+    magic, version, json_size, header_size, record_size, start_time_us, start_uptime_us = \
+        unpack_from(LOG_FILE_HEADER, raw)
+    if magic != LOG_FILE_MAGIC:
+        raise ValueError('Not a binary log file')
+    if version not in (1, 2, 3):
+        raise NotImplementedError(f'Unknown log version {version}')
+    json_start = calcsize(LOG_FILE_HEADER)
+    return dict(
+        version=version,
+        descr=json.loads(raw[json_start:json_start + json_size]) if json_size else None,
+        header_size=header_size,
+        record_size=record_size,
+        start_time_us=start_time_us,
+        start_uptime_us=start_uptime_us,
     )
-    return DataFrame(data, columns=data.dtype.names)
+
+
+def element_widths(log_meta):
+    """ Width in bytes of every element of the record, like LogRecord::layout """
+    widths = []
+    for field in dtype_from_meta(log_meta):
+        count = field[2][0] if len(field) > 2 else 1
+        widths += [numpy_dtype(field[1]).itemsize] * count
+    return widths
+
+
+def read_varint(raw, pos):
+    v = 0
+    shift = 0
+    while True:
+        b = raw[pos]
+        pos += 1
+        v |= (b & 0x7f) << shift
+        shift += 7
+        if b < 0x80:
+            return v, pos
+
+
+def decode_delta(raw, pos, prev, widths):
+    """ Inverse of log_delta_encode, returns (record, next pos) """
+    record = bytearray()
+    offset = 0
+    for width in widths:
+        z, pos = read_varint(raw, pos)
+        d = (z >> 1) ^ -(z & 1)
+        v = int.from_bytes(prev[offset:offset + width], 'little') + d
+        record += (v % (1 << (8 * width))).to_bytes(width, 'little')
+        offset += width
+    return bytes(record), pos
+
+
+def unframe_blocks(raw, pos):
+    """ Payload of valid blocks joined into runs, every run starts with entry.
+    Corrupted block or gap in seq ends the run, next one starts at first_entry
+    of valid block """
+    runs = []
+    run = None
+    prev_seq = None
+    while pos + LOG_BLOCK_SIZE <= len(raw):
+        sync, crc, seq, size, first_entry = unpack_from(LOG_BLOCK_HEADER, raw, pos)
+        start = pos + calcsize(LOG_BLOCK_HEADER)
+        pos += LOG_BLOCK_SIZE
+        if sync != LOG_BLOCK_SYNC or size > LOG_BLOCK_PAYLOAD \
+                or crc != zlib.crc32(raw[start - 8:start + size]):
+            run = None
+            continue
+        if run is not None and seq == prev_seq + 1:
+            run += raw[start:start + size]
+        elif first_entry < size:
+            run = bytearray(raw[start + first_entry:start + size])
+            runs.append(run)
+        else:
+            run = None
+        prev_seq = seq
+    return runs
+
+
+def split_streams(raw, pos, schemas=None, streams=None):
+    """ Split multiplexed entries into {stream name: (schema, records bytes)},
+    schemas and streams are passed to continue after corrupted part of file """
+    schemas = {} if schemas is None else schemas
+    streams = {} if streams is None else streams
+    prev = {}
+    while pos < len(raw):
+        tag = raw[pos]
+        if tag == LOG_TAG_SCHEMA:
+            if pos + calcsize(LOG_SCHEMA_DECL) > len(raw):
+                break
+            _, stream_tag, name_size, json_size, record_size = unpack_from(LOG_SCHEMA_DECL, raw, pos)
+            if name_size == 0 or json_size == 0 \
+                    or pos + calcsize(LOG_SCHEMA_DECL) + name_size + json_size > len(raw):
+                break  # zeros of preallocated space or declaration cut by power loss
+            pos += calcsize(LOG_SCHEMA_DECL)
+            name = raw[pos:pos + name_size].decode()
+            descr = json.loads(raw[pos + name_size:pos + name_size + json_size])
+            pos += name_size + json_size
+            schemas[stream_tag] = (name, descr, record_size, element_widths(descr))
+            streams.setdefault(name, (descr, bytearray()))
+        elif tag in schemas:
+            name, _, record_size, _ = schemas[tag]
+            if pos + 1 + record_size > len(raw):
+                break  # record cut by power loss
+            record = raw[pos + 1:pos + 1 + record_size]
+            streams[name][1].extend(record)
+            prev[tag] = record  # keyframe for delta records
+            pos += 1 + record_size
+        elif tag & LOG_TAG_DELTA and tag & ~LOG_TAG_DELTA in schemas:
+            tag &= ~LOG_TAG_DELTA
+            name, _, _, widths = schemas[tag]
+            try:
+                record, pos = decode_delta(raw, pos + 1, prev.get(tag, b''), widths)
+            except IndexError:
+                break  # record cut by power loss
+            if tag in prev:  # without keyframe values are unknown
+                streams[name][1].extend(record)
+                prev[tag] = record
+        else:
+            break  # zeros of preallocated space or garbage
+    return streams
+
+
+def load_log_bytes(raw, name):
+    """ Returns {stream name: DataFrame}, name is used for version 1 files """
+    header = read_log_header(raw)
+    if header['version'] == 1:
+        streams = {name: (header['descr'], raw[header['header_size']:])}
+    elif header['version'] == 2:
+        streams = split_streams(raw, header['header_size'])
+    else:
+        schemas, streams = {}, {}
+        for run in unframe_blocks(raw, header['header_size']):
+            split_streams(run, 0, schemas, streams)
+
+    tables = {}
+    for name, (descr, data) in streams.items():
+        dtype = numpy_dtype(dtype_from_meta(descr))
+        count = len(data) // dtype.itemsize
+        tables[name] = to_dataframe(frombuffer(bytes(data), dtype=dtype, count=count))
+    return tables
+
+
+def load_log_file(fname):
+    """ Returns {stream name: DataFrame} """
+    with open(fname, 'rb') as f:
+        raw = f.read()
+    return load_log_bytes(raw, fname.rsplit('/', 1)[-1].rsplit('.', 1)[0])
+
+
+def read_log_index(fname):
+    """ Entries of .bidx file next to .blog as (timestamp_us, offset, flags) """
+    with open(fname.rsplit('.', 1)[0] + '.bidx', 'rb') as f:
+        raw = f.read()
+    size = calcsize(LOG_INDEX_ENTRY)
+    return [unpack_from(LOG_INDEX_ENTRY, raw, pos) for pos in range(0, len(raw) - size + 1, size)]
+
+
+def load_log_window(fname, from_us, to_us):
+    """ Like load_log_file, but reads only records around esp_timer time window,
+    same as POST /read_log/* does on the device """
+    schemas = []
+    start, end = 0, None
+    for timestamp_us, offset, flags in read_log_index(fname):
+        if flags & LOG_INDEX_SCHEMA:
+            schemas.append(offset)
+        elif timestamp_us <= from_us:
+            start = offset
+        elif timestamp_us > to_us:
+            end = offset
+            break
+
+    with open(fname, 'rb') as f:
+        header = read_log_header(f.read(calcsize(LOG_FILE_HEADER)))
+        header_size = header['header_size']
+        framed = header['version'] >= 3
+        f.seek(0)
+        raw = f.read(header_size)
+        start = max(start, header_size)
+        for offset in schemas:
+            if offset >= start:
+                break
+            # in framed file schema has own blocks
+            decl_offset = offset + calcsize(LOG_BLOCK_HEADER) if framed else offset
+            f.seek(decl_offset)
+            _, _, name_size, json_size, _ = unpack_from(LOG_SCHEMA_DECL, f.read(calcsize(LOG_SCHEMA_DECL)))
+            size = calcsize(LOG_SCHEMA_DECL) + name_size + json_size
+            if framed:
+                size = -(-size // LOG_BLOCK_PAYLOAD) * LOG_BLOCK_SIZE
+            f.seek(offset)
+            raw += f.read(size)
+        f.seek(start)
+        raw += f.read() if end is None else f.read(end - start)
+    return load_log_bytes(raw, fname.rsplit('/', 1)[-1].rsplit('.', 1)[0])
 
 if __name__ == '__main__':
-    fname = argv[1].rsplit('.')[0]
-    load_log_file(fname).to_csv(f'{fname}.csv', index=False)
+    fname = argv[1]
+    for name, table in load_log_file(fname).items():
+        table.to_csv(f'{fname.rsplit(".", 1)[0]}_{name}.csv', index=False)
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef ESP_PLATFORM
+#include <esp_rom_crc.h>
+#endif
+
+/* CRC-32 (IEEE, same as zlib.crc32), ROM implementation on ESP32 */
+inline uint32_t log_crc32(const uint8_t* data, uint32_t size)
+{
+#ifdef ESP_PLATFORM
+    return esp_rom_crc32_le(0, data, size);
+#else
+    uint32_t crc = 0xffffffff;
+    while (size--)
+    {
+        crc ^= *(data++);
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+#endif
+}
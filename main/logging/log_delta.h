@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/* Zig-zag maps small negative and positive numbers to small unsigned ones */
+inline uint64_t zigzag_encode(int64_t v)
+{
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+inline uint8_t* write_varint(uint8_t* out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *(out++) = uint8_t(v) | 0x80;
+        v >>= 7;
+    }
+    *(out++) = uint8_t(v);
+    return out;
+}
+
+/* Worst case size of delta encoded record, 1 byte values take 2 bytes */
+constexpr uint32_t log_delta_max_size(uint32_t record_size)
+{
+    return 2 * record_size;
+}
+
+/**
+ * @brief Encode record as differences to previous one.
+ * Every element is treated as integer of its width (floats by their bits),
+ * difference is wrapped to that width, zig-zag and varint encoded.
+ *
+ * @param out at least log_delta_max_size(record size) bytes
+ * @param cur
+ * @param prev
+ * @param layout width in bytes of every element, zero terminated
+ * @return encoded size
+ */
+inline uint32_t log_delta_encode(
+    uint8_t* out, const uint8_t* cur, const uint8_t* prev, const char* layout)
+{
+    auto start = out;
+    for (; *layout; layout++)
+    {
+        uint32_t width = *layout;
+        uint64_t a = 0, b = 0;
+        memcpy(&a, cur, width);
+        memcpy(&b, prev, width);
+        cur += width;
+        prev += width;
+
+        auto shift = 64 - 8 * width;
+        // difference sign extended from element width
+        int64_t d = int64_t((a - b) << shift) >> shift;
+        out = write_varint(out, zigzag_encode(d));
+    }
+    return out - start;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* stream id of filler entry at the end of ring memory */
+#define LOG_RING_PAD 0xffff
+
+struct LogRingEntry
+{
+    uint16_t stream_id;
+    uint16_t size;          // payload size, without header
+    uint32_t timestamp_us;  // lower bits of producer time
+
+    uint8_t* data() { return (uint8_t*)(this + 1); }
+};
+
+/**
+ * @brief Wait-free single producer / single consumer ring of log records.
+ * Producer (control loop) reserves space, assembles record in place and
+ * commits it, consumer (SD writer task) reads records in the same order.
+ * Records never wrap around the end of memory, so both sides see every
+ * record as one continuous block.
+ */
+template <uint32_t ring_size>
+class LogRing
+{
+    static_assert(
+        (ring_size & (ring_size - 1)) == 0, "ring size must be power of 2");
+    static_assert(ring_size <= 0x10000, "entry size is 16 bit");
+
+    alignas(sizeof(LogRingEntry)) uint8_t data[ring_size];
+    std::atomic<uint32_t> head{0};  // written only by producer
+    std::atomic<uint32_t> tail{0};  // written only by consumer
+    uint32_t reserved_head = 0;
+
+    /* aligned to header size, so filler entry always fits at the end */
+    static constexpr uint32_t entry_size(uint32_t size)
+    {
+        return (sizeof(LogRingEntry) + size + sizeof(LogRingEntry) - 1)
+               & ~uint32_t(sizeof(LogRingEntry) - 1);
+    }
+
+    LogRingEntry* entry_at(uint32_t pos)
+    {
+        return (LogRingEntry*)(data + (pos & (ring_size - 1)));
+    }
+
+   public:
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> high_water{0};
+
+    /** Get space for the record payload, NULL when ring is full */
+    uint8_t* reserve(uint16_t stream_id, uint32_t size, uint32_t timestamp_us)
+    {
+        auto h = head.load(std::memory_order_relaxed);
+        auto t = tail.load(std::memory_order_acquire);
+        auto to_end = ring_size - (h & (ring_size - 1));
+        auto needed = entry_size(size);
+        auto pad = to_end < needed ? to_end : 0;
+
+        if (ring_size - (h - t) < needed + pad)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+
+        if (pad)
+        {  // skip rest of memory, consumer drops this entry
+            auto e = entry_at(h);
+            e->stream_id = LOG_RING_PAD;
+            e->size = pad - sizeof(LogRingEntry);
+            h += pad;
+        }
+
+        auto e = entry_at(h);
+        e->stream_id = stream_id;
+        e->size = size;
+        e->timestamp_us = timestamp_us;
+        reserved_head = h + needed;
+        return e->data();
+    }
+
+    /** Publish record from last reserve() */
+    void commit()
+    {
+        auto used = reserved_head - tail.load(std::memory_order_relaxed);
+        if (used > high_water.load(std::memory_order_relaxed))
+        {
+            high_water.store(used, std::memory_order_relaxed);
+        }
+        head.store(reserved_head, std::memory_order_release);
+    }
+
+    /** Oldest record or NULL if ring is empty */
+    LogRingEntry* front()
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        while (t != head.load(std::memory_order_acquire))
+        {
+            auto e = entry_at(t);
+            if (e->stream_id != LOG_RING_PAD)
+            {
+                return e;
+            }
+            t += entry_size(e->size);
+            tail.store(t, std::memory_order_release);
+        }
+        return NULL;
+    }
+
+    /** Release record returned by front() */
+    void pop()
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        tail.store(
+            t + entry_size(entry_at(t)->size), std::memory_order_release);
+    }
+
+    uint32_t capacity() { return ring_size; }
+};
@@ -3,8 +3,31 @@
 
 static const char TAG[] = "SDcard";
 
+/* wall clock before 2020 means it was never set */
+constexpr static time_t LOG_VALID_TIME_S = 1577836800;
+
 TaskHandle_t SDcard_task_handle = NULL;
 
+LogRing<LOG_RING_SIZE> log_ring;
+LogStreamDescr log_streams[LOG_MAX_STREAMS];
+std::atomic<uint16_t> log_streams_count{0};
+
+/* used only by SDcard_task */
+static LogWriter<FatfsLogFile, FatfsIndexFile> log_writer;
+static std::atomic<bool> log_close_requested{false};
+static uint32_t log_run = UINT32_MAX;  // UINT32_MAX - new run on next open
+static uint32_t log_segment;
+static int64_t log_segment_start_us;
+static int64_t log_sync_us;  // last sync of open log file
+
+/* flight recorder, oldest records are dropped from history to make space */
+static LogRing<LOG_HISTORY_SIZE> log_history;
+static std::atomic<LogMode> log_mode{LOG_MODE_CONTINUOUS};
+static LogMode log_active_mode = LOG_MODE_CONTINUOUS;
+static std::atomic<bool> log_trigger_requested{false};
+static std::atomic<uint32_t> log_trigger_time_us{0};  // lower bits like ring
+static int64_t log_trigger_end_us = 0;  // 0 - not saving trigger window
+
 esp_vfs_fat_sdmmc_mount_config_t mount_config = {
     .format_if_mount_failed = false,
     .max_files = 3,
@@ -56,43 +79,338 @@ void sd_card_init()
     f_mkdir("logs");
     f_mkdir("webpage");
 
-    /* start wifi manager task */
+    /* start SD writer task, low priority - producers never wait for it */
     ESP_LOGI(TAG, "Task started!");
 
-    xTaskCreate(
+    xTaskCreatePinnedToCore(
         &SDcard_task,
         "SDcard_task",
         4096,
         NULL,
-        configMAX_PRIORITIES - 1,
-        &SDcard_task_handle);
+        tskIDLE_PRIORITY + 1,
+        &SDcard_task_handle,
+        CORE_SYSTEM);
+}
+
+bool FatfsLogFile::open(const char* fname, const char* mode)
+{
+    bool create = mode[0] == 'w';
+    auto res = f_open(
+        &fil, fname, FA_WRITE | (create ? FA_CREATE_ALWAYS : FA_OPEN_EXISTING));
+    if (res != FR_OK)
+    {
+        return false;
+    }
+    opened = true;
+
+    if (!create)
+    {
+        f_lseek(&fil, f_size(&fil));
+        return true;
+    }
+
+    if (prealloc_size)
+    {
+#if FF_USE_EXPAND
+        res = f_expand(&fil, prealloc_size, 1);
+#else
+        /* clusters are allocated up front, but may be fragmented */
+        res = f_lseek(&fil, prealloc_size);
+        f_lseek(&fil, 0);
+#endif
+        if (res != FR_OK)
+        {
+            ESP_LOGW(TAG, "Preallocation of %s failed (%d)", fname, res);
+        }
+    }
+    /* file exists on the card even if it is never closed */
+    f_sync(&fil);
+    return true;
+}
+
+void FatfsLogFile::write(const uint8_t* data, uint32_t size)
+{
+    UINT written = 0;
+    auto res = f_write(&fil, data, size, &written);
+    if (unlikely(res != FR_OK || written != size))
+    {
+        ESP_LOGE(TAG, "Log write failed (%d)", res);
+    }
+}
+
+void FatfsLogFile::close()
+{
+    /* drop unused part of preallocated space */
+    f_truncate(&fil);
+    f_close(&fil);
+    opened = false;
+}
+
+uint16_t log_register_stream(const LogStreamDescr& descr)
+{
+    auto id = log_streams_count.load();
+    if (id >= LOG_MAX_STREAMS)
+    {
+        ESP_LOGE(TAG, "Too many log streams, %s not logged", descr.name);
+        return LOG_RING_PAD;
+    }
+
+    log_streams[id] = descr;
+    log_streams_count.store(id + 1);
+    return id;
+}
+
+int64_t log_timestamp_us() { return esp_timer_get_time(); }
+
+/**
+ * @brief Create next segment of the run, logs/log_RRR_SSS.blog and .bidx.
+ * Every run gets next free number so previous logs are never appended or
+ * overwritten.
+ */
+static bool open_log_file()
+{
+    char fname[40];
+    char index_fname[40];
+    FILINFO info;
+    if (log_run == UINT32_MAX)
+    {
+        log_run = 0;
+        log_segment = 0;
+        do
+        {
+            snprintf(
+                fname,
+                sizeof(fname),
+                "logs/log_%03" PRIu32 "_000.blog",
+                log_run++);
+        } while (f_stat(fname, &info) == FR_OK);
+        log_run--;
+    }
+    snprintf(
+        fname,
+        sizeof(fname),
+        "logs/log_%03" PRIu32 "_%03" PRIu32 ".blog",
+        log_run,
+        log_segment);
+    snprintf(
+        index_fname,
+        sizeof(index_fname),
+        "logs/log_%03" PRIu32 "_%03" PRIu32 ".bidx",
+        log_run,
+        log_segment);
+    log_segment++;
+
+    ESP_LOGI(TAG, "Opening log %s", fname);
+
+    timeval now;
+    gettimeofday(&now, NULL);
+    log_segment_start_us = esp_timer_get_time();
+    if (!log_writer.open(
+            fname,
+            index_fname,
+            now.tv_sec < LOG_VALID_TIME_S ? 0
+                                          : now.tv_sec * 1000000ll + now.tv_usec,
+            log_segment_start_us))
+    {
+        ESP_LOGE(TAG, "Failed to open file for writing");
+        return false;
+    }
+    return true;
+}
+
+/* Close segment which is full or too long, next record opens new one */
+static void rotate_log_file(int64_t now)
+{
+    if (log_writer.position() >= LOG_SEGMENT_SIZE
+        || (LOG_SEGMENT_DURATION_US
+            && now - log_segment_start_us >= LOG_SEGMENT_DURATION_US))
+    {
+        log_writer.close();
+    }
+}
+
+/**
+ * @brief Restore upper bits of record time, records are within 2^31 us of now
+ * either way - the control task keeps pushing while the card is written, so
+ * they may be younger than now read before the drain
+ */
+static int64_t log_extend_time(int64_t now, uint32_t timestamp_us)
+{
+    return now + int32_t(timestamp_us - uint32_t(now));
+}
+
+static void log_write_entry(LogRingEntry* e, int64_t timestamp_us, int64_t now)
+{
+    auto id = e->stream_id;
+    if (likely(id < LOG_MAX_STREAMS)
+        && (log_writer.is_open() || open_log_file()))
+    {
+        log_writer.write(id, log_streams[id], e->data(), e->size, timestamp_us);
+        rotate_log_file(now);
+    }
+}
+
+static void log_keep_entry(LogRingEntry* e)
+{
+    uint8_t* buf;
+    while (!(buf = log_history.reserve(e->stream_id, e->size, e->timestamp_us))
+           && log_history.front())
+    {
+        log_history.pop();
+    }
+    if (buf)
+    {
+        memcpy(buf, e->data(), e->size);
+        log_history.commit();
+    }
+}
+
+/* Mode change and trigger are handled here, file is used only by SDcard_task */
+static void log_handle_requests(int64_t now)
+{
+    auto mode = log_mode.load();
+    if (mode != log_active_mode)
+    {
+        log_writer.close();
+        log_run = UINT32_MAX;
+        log_trigger_end_us = 0;
+        while (log_history.front())
+        {
+            log_history.pop();
+        }
+        log_active_mode = mode;
+    }
+
+    if (log_trigger_requested.exchange(false)
+        && log_active_mode == LOG_MODE_FLIGHT_RECORDER)
+    {
+        auto trigger_us = log_extend_time(now, log_trigger_time_us.load());
+        if (!log_trigger_end_us)
+        {
+            /* every event gets own run */
+            log_run = UINT32_MAX;
+            LogRingEntry* e = log_history.front();
+            auto covered_us =
+                e ? trigger_us - log_extend_time(now, e->timestamp_us) : 0;
+            if (covered_us < LOG_PRETRIGGER_US)
+            {  // more records than LOG_HISTORY_BYTES_PER_S, or mode just set
+                ESP_LOGW(
+                    TAG,
+                    "History covers only %lld of %lld us before trigger",
+                    covered_us,
+                    LOG_PRETRIGGER_US);
+            }
+            while ((e = log_history.front()) != NULL)
+            {
+                auto timestamp_us = log_extend_time(now, e->timestamp_us);
+                if (timestamp_us >= trigger_us - LOG_PRETRIGGER_US)
+                {
+                    log_write_entry(e, timestamp_us, now);
+                }
+                log_history.pop();
+            }
+        }
+        /* next trigger during window extends it */
+        log_trigger_end_us = trigger_us + LOG_POSTTRIGGER_US;
+        ESP_LOGI(TAG, "Log trigger, saving until %lld us", log_trigger_end_us);
+    }
 }
 
 /**
- * @brief Loging data to SD card - only for loging purposes
+ * @brief Move all records from log_ring to the log file, in flight recorder
+ * mode to RAM history outside of trigger window
  *
+ * @return number of records written
  */
-void SDcard_task(void* pvParameters)
+uint32_t log_write_pending()
 {
-    uint32_t val = 666;
-    uint32_t val1 = 777;
-    uint32_t time = 0;
+    uint32_t count = 0;
+    int64_t now = esp_timer_get_time();
+    log_handle_requests(now);
 
-    while (1)
+    LogRingEntry* e;
+    while ((e = log_ring.front()) != NULL)
     {
-        vTaskDelay(pdMS_TO_TICKS(10));
-        // Write/Read tests
-        // const char* myString = "Lubie Kotki!";
-        // save_data("/sdcard/logs/data.gz", myString);
+        auto timestamp_us = log_extend_time(now, e->timestamp_us);
+        if (log_active_mode == LOG_MODE_CONTINUOUS)
+        {
+            log_write_entry(e, timestamp_us, now);
+        }
+        else if (log_trigger_end_us && timestamp_us <= log_trigger_end_us)
+        {
+            log_write_entry(e, timestamp_us, now);
+        }
+        else
+        {
+            if (log_trigger_end_us)
+            {  // end of trigger window
+                log_writer.close();
+                log_trigger_end_us = 0;
+            }
+            log_keep_entry(e);
+        }
+        log_ring.pop();
+        count++;
+    }
+
+    if (log_writer.is_open() && now - log_sync_us >= LOG_SYNC_INTERVAL_US)
+    {
+        log_writer.sync();
+        log_sync_us = now;
+    }
+    return count;
+}
+
+/**
+ * @brief Flush and close the log file in SDcard_task, e.g. before power off.
+ * Next record starts new run.
+ */
+void log_request_close() { log_close_requested.store(true); }
 
-        // save_logs("/sdcard/data1.txt", (void *)myString);
+/**
+ * @brief LOG_MODE_FLIGHT_RECORDER keeps last LOG_HISTORY_SIZE bytes of records
+ * in RAM, so logging at full loop rate does not load SD card
+ */
+void log_set_mode(LogMode mode) { log_mode.store(mode); }
+
+LogMode log_get_mode() { return log_mode.load(); }
+
+/**
+ * @brief Save LOG_PRETRIGGER_US before and LOG_POSTTRIGGER_US after now to new
+ * log run, e.g. on line lost or motor stall. Safe to call from any task.
+ */
+void log_trigger()
+{
+    log_trigger_time_us.store(uint32_t(esp_timer_get_time()));
+    log_trigger_requested.store(true);
+}
 
-        // vTaskDelay(1000/ portTICK_PERIOD_MS);
-        // read_data_to_logs("/sdcard/data1.txt");
+LogStats log_get_stats()
+{
+    return {
+        .dropped = log_ring.dropped.load(),
+        .high_water = log_ring.high_water.load(),
+        .capacity = log_ring.capacity(),
+    };
+}
 
-        // PJ binary logging method
-        time++;
-        LOG_VALUES("data3", time, val, val1);
+/**
+ * @brief Loging data to SD card - drains log_ring filled by LOG_VALUES
+ *
+ */
+void SDcard_task(void* pvParameters)
+{
+    while (1)
+    {
+        if (!log_write_pending())
+        {
+            if (log_close_requested.exchange(false))
+            {
+                log_writer.close();
+                log_run = UINT32_MAX;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
     }
     vTaskDelete(NULL);
 }
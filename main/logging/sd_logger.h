@@ -1,21 +1,102 @@
 #pragma once
 
 #include <driver/sdmmc_host.h>
+#include <esp_timer.h>
 #include <esp_vfs_fat.h>
 #include <sdmmc_cmd.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <cstdint>
 
+#include "../cores.h"
 #include "binary_logging.h"
 #include "hal/gpio_types.h"
 
 #define SD_MOUNT "/sdcard"
 #define MAX_RECORD_SIZE 1024
 
+/* Size reserved for new log file at creation, 0 - grow cluster by cluster */
+#define LOG_PREALLOC_SIZE (16 * 1024 * 1024)
+
+/* New segment of the run is started when current reaches size or duration */
+#define LOG_SEGMENT_SIZE LOG_PREALLOC_SIZE
+#define LOG_SEGMENT_DURATION_US (10 * 60 * 1000000ll)  // 0 - no limit
+
+/* Open log file is synced (directory entry, index) at most this much apart */
+#define LOG_SYNC_INTERVAL_US (1 * 1000000ll)
+
+/**
+ * Flight recorder - RAM history of records and window saved on trigger.
+ * History keeps raw ring entries (8 B header, 8 B aligned). The 1 kHz loop
+ * pushes about 193 B of them per cycle (control_timing, sensor_frame, line,
+ * motion, line_follower, wheel_speed), so 64 KB, the LogRing limit, hold
+ * about 0.35 s. Pretrigger is what fits with 10 % margin, about 0.3 s.
+ */
+#define LOG_HISTORY_SIZE (64 * 1024)
+#define LOG_HISTORY_BYTES_PER_S (193 * 1000)
+#define LOG_PRETRIGGER_US \
+    (LOG_HISTORY_SIZE * 900000ll / LOG_HISTORY_BYTES_PER_S)
+#define LOG_POSTTRIGGER_US (2 * 1000000ll)
+
+enum LogMode : uint8_t
+{
+    LOG_MODE_CONTINUOUS,      // every record goes to SD card
+    LOG_MODE_FLIGHT_RECORDER  // records stay in RAM until log_trigger()
+};
+
+/**
+ * @brief Log file written with FatFs API, path relative to card root.
+ * New file gets LOG_PREALLOC_SIZE in one contiguous extent, so no FAT
+ * updates are needed while writing, close truncates it to the written length.
+ * Directory entry is written only by f_sync or f_close, so the extent is
+ * synced right after preallocation and SDcard_task calls sync() every
+ * LOG_SYNC_INTERVAL_US. File not closed (power loss) keeps preallocated size,
+ * with data up to the last written block and stale sectors after it.
+ */
+class FatfsLogFile
+{
+    FIL fil;
+    bool opened = false;
+    uint32_t prealloc_size;
+
+   public:
+    FatfsLogFile(uint32_t prealloc_size = LOG_PREALLOC_SIZE)
+        : prealloc_size(prealloc_size)
+    {
+    }
+
+    bool is_open() { return opened; }
+    bool open(const char* fname, const char* mode);
+    uint32_t size() { return f_tell(&fil); }
+    void write(const uint8_t* data, uint32_t size);
+    void sync() { f_sync(&fil); }
+    void close();
+};
+
+/* .bidx is small and rewritten rarely, so no preallocation */
+class FatfsIndexFile : public FatfsLogFile
+{
+   public:
+    FatfsIndexFile() : FatfsLogFile(0) {}
+};
+
+struct LogStats
+{
+    uint32_t dropped;     // records not fitting in log_ring
+    uint32_t high_water;  // max bytes used in log_ring
+    uint32_t capacity;
+};
+
 void sd_card_init();
+uint32_t log_write_pending();
+LogStats log_get_stats();
+void log_request_close();
+void log_set_mode(LogMode mode);
+LogMode log_get_mode();
+void log_trigger();
 void save_data(const char* fname, const char* data);
 void save_logs(const char* fname, void* data);
 void read_data_to_logs(const char* fname);
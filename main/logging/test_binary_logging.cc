@@ -1,18 +1,275 @@
-// g++ test_binary_logging.cc -o test_binary_logging.e -O2 -s && ./test_binary_logging.e
-#include <cstdio>
+// g++ test_binary_logging.cc -o test_binary_logging.e -std=c++17 -O2 -s -pthread && ./test_binary_logging.e [dir]
+/* Host benchmark of the logging path, numbers to compare before flashing */
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
 
-#define BINARY_LOG_LOCATION "."
-#define likely(v) v
+#define likely(v) __builtin_expect(!!(v), 1)
+#define unlikely(v) __builtin_expect(!!(v), 0)
 
 #include "binary_logging.h"
 
 using namespace std;
+using bench_clock = chrono::steady_clock;
+
+/* Defined in sd_logger.cc on the device */
+LogRing<LOG_RING_SIZE> log_ring;
+LogStreamDescr log_streams[LOG_MAX_STREAMS];
+std::atomic<uint16_t> log_streams_count{0};
+
+uint16_t log_register_stream(const LogStreamDescr& descr)
+{
+    auto id = log_streams_count.load();
+    log_streams[id] = descr;
+    log_streams_count.store(id + 1);
+    return id;
+}
+
+int64_t log_timestamp_us()
+{
+    return chrono::duration_cast<chrono::microseconds>(
+               bench_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief SD card like device: every write waits for command latency and
+ * transfer, sometimes much longer (card internal erase)
+ */
+class SlowBlockFile : public StdioLogFile
+{
+   public:
+    static constexpr uint32_t latency_us = 300;
+    static constexpr uint32_t bytes_per_ms = 2 * 1024;  // 2 MB/s
+    static constexpr uint32_t stall_every = 64;
+    static constexpr uint32_t stall_us = 100000;
+
+    uint32_t writes = 0;
+
+    void write(const uint8_t* data, uint32_t size)
+    {
+        uint32_t wait_us = latency_us + size * 1000 / bytes_per_ms;
+        if (++writes % stall_every == 0)
+        {
+            wait_us += stall_us;
+        }
+        this_thread::sleep_for(chrono::microseconds(wait_us));
+        StdioLogFile::write(data, size);
+    }
+};
+
+struct Latencies
+{
+    vector<uint32_t> ns;
+
+    void print(const char* name, uint64_t bytes, double total_s)
+    {
+        sort(ns.begin(), ns.end());
+        auto p = [&](double q) { return ns[size_t(q * (ns.size() - 1))]; };
+        printf(
+            "%-28s %9.0f rec/s %8.2f MB/s  p50 %5" PRIu32 " p99 %6" PRIu32
+            " p99.9 %7" PRIu32 " max %8" PRIu32 " ns\n",
+            name,
+            ns.size() / total_s,
+            bytes / total_s / 1e6,
+            p(0.5),
+            p(0.99),
+            p(0.999),
+            ns.back());
+    }
+};
+
+template <class Tfn>
+void bench(const char* name, uint32_t count, uint32_t record_size, Tfn fn)
+{
+    Latencies lat;
+    lat.ns.reserve(count);
+    auto start = bench_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto t0 = bench_clock::now();
+        fn(i);
+        lat.ns.push_back(
+            chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - t0)
+                .count());
+    }
+    chrono::duration<double> total = bench_clock::now() - start;
+    lat.print(name, uint64_t(count) * record_size, total.count());
+}
 
-int main() {
-    for (int i=0; i<100; i++) {
+/* Typical control loop record */
+struct Sample
+{
+    uint32_t t;
+    float e, u;
+    int16_t adc[8];
+};
+
+static Sample sample(uint32_t i)
+{
+    Sample s = {.t = i, .e = sinf(i * 0.01f), .u = cosf(i * 0.01f), .adc = {}};
+    for (int k = 0; k < 8; k++)
+    {
+        s.adc[k] = int16_t(2000 + 100 * sinf(i * 0.02f + k));
+    }
+    return s;
+}
+
+/* Producer thread like the control loop, SDcard_task drains log_ring */
+template <class Tfile>
+void bench_ring(const char* name, const string& base, uint32_t count)
+{
+    LogWriter<Tfile> writer;
+    writer.open((base + ".blog").c_str(), (base + ".bidx").c_str(), 0, 0);
+    atomic<bool> done{false};
+    uint64_t written = 0;
+
+    thread consumer(
+        [&]()
+        {
+            while (true)
+            {
+                auto finished = done.load();
+                LogRingEntry* e;
+                while ((e = log_ring.front()) != NULL)
+                {
+                    auto id = e->stream_id;
+                    writer.write(
+                        id, log_streams[id], e->data(), e->size, 0);
+                    written++;
+                    log_ring.pop();
+                }
+                if (finished)
+                {
+                    break;
+                }
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        });
+
+    auto dropped = log_ring.dropped.load();
+    // 4 kHz, faster than control loop so stalls fill the ring,
+    // only LOG_VALUES call is measured
+    Latencies lat;
+    lat.ns.reserve(count);
+    auto start = bench_clock::now();
+    auto next = start;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto s = sample(i);
+        auto t0 = bench_clock::now();
+        LOG_VALUES_DELTA("bench", s.t, s.e, s.u, s.adc);
+        lat.ns.push_back(
+            chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - t0)
+                .count());
+        next += chrono::microseconds(250);
+        this_thread::sleep_until(next);
+    }
+    chrono::duration<double> total = bench_clock::now() - start;
+    lat.print(name, uint64_t(count) * sizeof(Sample), total.count());
+    done.store(true);
+    consumer.join();
+    writer.close();
+    printf(
+        "%-28s written %" PRIu64 " dropped %" PRIu32 " ring high water %" PRIu32
+        "/%" PRIu32 "\n",
+        "",
+        written,
+        log_ring.dropped.load() - dropped,
+        log_ring.high_water.load(),
+        log_ring.capacity());
+}
+
+int main(int argc, char** argv)
+{
+    // tmpfs, so only logging code is measured
+    string dir = argc > 1 ? argv[1] : "/dev/shm";
+    constexpr uint32_t count = 200000;
+
+    for (int i = 0; i < 100; i++)
+    {
         int b = i + 2;
-        LOG_VALUES(i, b);
+        LOG_VALUES("test", i, b);
+    }
+    while (log_ring.front())
+    {
+        log_ring.pop();
+    }
+
+    uint8_t buf[MAX_LOG_RECORD_SIZE];
+    bench(
+        "assemble_record",
+        count,
+        sizeof(Sample),
+        [&](uint32_t i)
+        {
+            auto s = sample(i);
+            assemble_record(buf, s.t, s.e, s.u, s.adc);
+        });
+
+    auto F = fopen((dir + "/bench_write_record.bin").c_str(), "wb");
+    bench(
+        "write_record (fflush)",
+        count,
+        sizeof(Sample),
+        [&](uint32_t i)
+        {
+            auto s = sample(i);
+            write_record(F, s.t, s.e, s.u, s.adc);
+        });
+    fclose(F);
+
+    LogWriter<StdioLogFile> writer;
+    writer.open(
+        (dir + "/bench_writer.blog").c_str(),
+        (dir + "/bench_writer.bidx").c_str(),
+        0,
+        0);
+    static constexpr auto descr =
+        LogRecord<uint32_t, float, float, int16_t[8]>::json_descr("t,e,u,adc");
+    using record_t = LogRecord<uint32_t, float, float, int16_t[8]>;
+    LogStreamDescr raw = {
+        .name = "raw",
+        .json_descr = descr.c_str(),
+        .layout = record_t::layout.c_str(),
+        .record_size = record_t::size,
+        .flags = 0,
+    };
+    LogStreamDescr delta = raw;
+    delta.name = "delta";
+    delta.flags = LOG_STREAM_DELTA;
+    for (auto* stream : {&raw, &delta})
+    {
+        auto id = stream == &raw ? 0 : 1;
+        auto name = string("LogWriter ") + stream->name;
+        bench(
+            name.c_str(),
+            count,
+            sizeof(Sample),
+            [&](uint32_t i)
+            {
+                auto s = sample(i);
+                record_t::assemble(buf, s.t, s.e, s.u, s.adc);
+                writer.write(id, *stream, buf, record_t::size, i);
+            });
     }
+    auto file_size = writer.position();
+    writer.close();
+    printf(
+        "%-28s %" PRIu32 " B file for %" PRIu32 " B of records\n",
+        "",
+        file_size,
+        2 * count * record_t::size);
+
+    bench_ring<StdioLogFile>(
+        "LOG_VALUES ring -> tmpfs", dir + "/bench_ring", 20000);
+    bench_ring<SlowBlockFile>(
+        "LOG_VALUES ring -> slow dev", dir + "/bench_slow", 20000);
     return 0;
 }
@@ -0,0 +1,98 @@
+/* Deferred formatting of TRACE_LOGx messages */
+#include "trace_log.h"
+
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include <cinttypes>
+
+#include "../cores.h"
+
+static const char TAG[] = "trace";
+
+TaskHandle_t trace_task_handle = NULL;
+
+LogRing<TRACE_RING_SIZE> trace_ring;
+portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> trace_started{false};
+
+static const char trace_level_letters[] = "NEWIDV";
+
+/**
+ * @brief Format and print all messages waiting in trace_ring, output looks
+ * like ESP_LOGx with the time of TRACE_LOGx call
+ *
+ * @return number of messages
+ */
+static uint32_t trace_print_pending()
+{
+    static char message[TRACE_MAX_MESSAGE_SIZE];
+    uint32_t count = 0;
+    int64_t now = esp_timer_get_time();
+    LogRingEntry* e;
+    while ((e = trace_ring.front()) != NULL)
+    {
+        const TraceSite* site;
+        memcpy(&site, e->data(), sizeof(site));
+        site->format_fn(
+            site->format,
+            e->data() + sizeof(site),
+            message,
+            sizeof(message));
+
+        // within 2^31 us of now, may be pushed after now while printing
+        int64_t timestamp_us = now + int32_t(e->timestamp_us - uint32_t(now));
+        esp_log_write(
+            site->level,
+            site->tag,
+            "%c (%" PRIu32 ") %s: %s\n",
+            trace_level_letters[site->level],
+            uint32_t(timestamp_us / 1000),
+            site->tag,
+            message);
+
+        trace_ring.pop();
+        count++;
+    }
+    return count;
+}
+
+/** Low priority task doing printf and UART work of TRACE_LOGx */
+void trace_task(void* pvParameters)
+{
+    uint32_t dropped = 0;
+    while (1)
+    {
+        if (!trace_print_pending())
+        {
+            auto now_dropped = trace_ring.dropped.load();
+            if (now_dropped != dropped)
+            {
+                ESP_LOGW(
+                    TAG,
+                    "%" PRIu32 " messages dropped",
+                    now_dropped - dropped);
+                dropped = now_dropped;
+            }
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/* Start trace_task, next calls do nothing */
+void trace_log_init()
+{
+    if (trace_started.exchange(true))
+    {
+        return;
+    }
+    xTaskCreatePinnedToCore(
+        &trace_task,
+        "trace_task",
+        3072,
+        NULL,
+        tskIDLE_PRIORITY + 1,
+        &trace_task_handle,
+        CORE_SYSTEM);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <esp_compiler.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "log_ring.h"
+
+/* Messages waiting for formatting in trace_task */
+#define TRACE_RING_SIZE (8 * 1024)
+#define TRACE_MAX_MESSAGE_SIZE 256
+
+typedef int (*TraceFormatFn)(
+    const char* format, const uint8_t* args, char* out, uint32_t out_size);
+
+/* Static description of TRACE_LOGx call site, ring keeps only pointer to it */
+struct TraceSite
+{
+    esp_log_level_t level;
+    const char* tag;
+    const char* format;
+    TraceFormatFn format_fn;
+};
+
+/**
+ * @brief Arguments of the call site stored as raw bytes.
+ * Pointers are stored as they are, so only string literals and other static
+ * strings can be passed for %s.
+ */
+template <class... Targs>
+struct TraceArgs
+{
+    static_assert(
+        ((std::is_arithmetic_v<Targs> || std::is_pointer_v<Targs>) && ...),
+        "only numbers and static strings can be traced");
+
+    static constexpr uint32_t size = (0 + ... + sizeof(Targs));
+
+    static void assemble(uint8_t* buf, const Targs&... args)
+    {
+        ((memcpy(buf, &args, sizeof(args)), buf += sizeof(args)), ...);
+    }
+
+    static constexpr uint32_t offset(uint32_t i)
+    {
+        constexpr uint32_t sizes[] = {sizeof(Targs)..., 0};
+        uint32_t pos = 0;
+        for (uint32_t k = 0; k < i; k++)
+        {
+            pos += sizes[k];
+        }
+        return pos;
+    }
+
+    template <class T>
+    static T load(const uint8_t* data)
+    {
+        T v;
+        memcpy(&v, data, sizeof(v));
+        return v;
+    }
+
+    template <size_t... I>
+    static int format_args(
+        const char* format,
+        const uint8_t* args,
+        char* out,
+        uint32_t out_size,
+        std::index_sequence<I...>)
+    {
+        return snprintf(
+            out, out_size, format, load<Targs>(args + offset(I))...);
+    }
+
+    static int format(
+        const char* format, const uint8_t* args, char* out, uint32_t out_size)
+    {
+        return format_args(
+            format, args, out, out_size, std::index_sequence_for<Targs...>{});
+    }
+};
+
+/* Only for decltype in TRACE_LOG_LEVEL, arguments are decayed like in printf */
+template <class... Targs>
+TraceArgs<std::decay_t<const Targs&>...> trace_args_of(const Targs&...);
+
+/* Never called, lets compiler check format like in ESP_LOGx */
+inline void trace_check_format(const char* format, ...)
+    __attribute__((format(printf, 1, 2)));
+inline void trace_check_format(const char*, ...) {}
+
+extern LogRing<TRACE_RING_SIZE> trace_ring;
+extern portMUX_TYPE trace_mux;
+
+/* Call from a task at startup, messages traced before wait in trace_ring */
+void trace_log_init();
+int64_t log_timestamp_us();
+
+/**
+ * Put message to trace_ring, many tasks can trace, so it is locked. Only
+ * enqueues, so it can be called from ISR and esp_timer callbacks.
+ */
+template <class Targs, class... Tvalues>
+void trace_push(const TraceSite* site, const Tvalues&... values)
+{
+    uint32_t timestamp_us = log_timestamp_us();
+    portENTER_CRITICAL_SAFE(&trace_mux);
+    auto buf =
+        trace_ring.reserve(0, sizeof(site) + Targs::size, timestamp_us);
+    if (likely(buf))
+    {
+        memcpy(buf, &site, sizeof(site));
+        Targs::assemble(buf + sizeof(site), values...);
+        trace_ring.commit();
+    }
+    portEXIT_CRITICAL_SAFE(&trace_mux);
+}
+
+/**
+ * @brief Zamiennik ESP_LOGx do szybkich pętli - zapisuje tylko wskaźnik
+ * na opis miejsca wywołania i surowe argumenty, printf i UART robi trace_task
+ * z niskim priorytetem. Wywołanie kosztuje tyle co kopiowanie argumentów.
+ */
+#define TRACE_LOG_LEVEL(LEVEL, TRACE_TAG, FORMAT, ...)                         \
+    do                                                                         \
+    {                                                                          \
+        if (LOG_LOCAL_LEVEL >= LEVEL)                                          \
+        {                                                                      \
+            if (0)                                                             \
+            {                                                                  \
+                trace_check_format(FORMAT, ##__VA_ARGS__);                     \
+            }                                                                  \
+            using trace_args_t = decltype(trace_args_of(__VA_ARGS__));         \
+            static const TraceSite trace_site = {                              \
+                .level = LEVEL,                                                \
+                .tag = TRACE_TAG,                                              \
+                .format = FORMAT,                                              \
+                .format_fn = &trace_args_t::format,                            \
+            };                                                                 \
+            trace_push<trace_args_t>(&trace_site, ##__VA_ARGS__);              \
+        }                                                                      \
+    } while (0)
+
+#define TRACE_LOGE(tag, format, ...)                                           \
+    TRACE_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define TRACE_LOGW(tag, format, ...)                                           \
+    TRACE_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define TRACE_LOGI(tag, format, ...)                                           \
+    TRACE_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define TRACE_LOGD(tag, format, ...)                                           \
+    TRACE_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define TRACE_LOGV(tag, format, ...)                                           \
+    TRACE_LOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
@@ -0,0 +1,93 @@
+#include "motor_lut.h"
+
+/* Sweep noise around standstill, counted as deadband [m/s] */
+#define MOTOR_LUT_NOISE 0.02f
+
+/**
+ * @brief Turn speeds measured by the sweep into the table used by
+ * motor_lut_duty(): deadband set to exactly zero, speed made monotonic from
+ * the stop point outwards, scaled to 1 at full speed of the slower motor
+ *
+ * @return false if a motor did not reach MOTOR_LUT_MIN_SPEED either way
+ */
+bool motor_lut_prepare(MotorLut* lut) {
+    constexpr uint32_t stop = (MOTOR_LUT_POINTS - 1) / 2;
+    float top = 0;
+    for (uint32_t m = 0; m < MOTOR_COUNT; m++) {
+        float* speed = lut->speed[m];
+        float forward = speed[MOTOR_LUT_POINTS - 1], reverse = -speed[0];
+        if (forward < MOTOR_LUT_MIN_SPEED || reverse < MOTOR_LUT_MIN_SPEED) {
+            return false;
+        }
+        top = m == 0 || forward < top ? forward : top;
+        top = reverse < top ? reverse : top;
+
+        speed[stop] = 0;
+        for (uint32_t k = stop + 1; k < MOTOR_LUT_POINTS; k++) {
+            float v = speed[k] < MOTOR_LUT_NOISE ? 0 : speed[k];
+            speed[k] = v > speed[k - 1] ? v : speed[k - 1];
+        }
+        for (uint32_t k = stop; k-- > 0;) {
+            float v = speed[k] > -MOTOR_LUT_NOISE ? 0 : speed[k];
+            speed[k] = v < speed[k + 1] ? v : speed[k + 1];
+        }
+    }
+    for (uint32_t m = 0; m < MOTOR_COUNT; m++) {
+        for (uint32_t k = 0; k < MOTOR_LUT_POINTS; k++) {
+            lut->speed[m][k] /= top;
+        }
+    }
+    lut->version = MOTOR_LUT_VERSION;
+    return true;
+}
+
+/**
+ * @brief Duty giving the speed that duty means at nominal battery voltage,
+ * linear in speed: MOTOR_DUTY_STOP +- 0.5 is +- full speed. The table skips
+ * the deadband and evens out both motors, without table only the battery
+ * voltage is compensated.
+ *
+ * @param battery_v measured, below MOTOR_BATTERY_MIN_V not compensated
+ */
+float motor_lut_duty(const MotorLut& lut, uint32_t motor, float duty, float battery_v) {
+    float scale = battery_v > MOTOR_BATTERY_MIN_V ? MOTOR_BATTERY_NOMINAL_V / battery_v : 1.f;
+    float target = 2 * (duty - MOTOR_DUTY_STOP) * scale;
+    if (lut.version != MOTOR_LUT_VERSION) {
+        return MOTOR_DUTY_STOP + 0.5f * target;
+    }
+
+    const float* speed = lut.speed[motor];
+    if (target == 0) {
+        return MOTOR_DUTY_STOP;
+    }
+    if (target >= speed[MOTOR_LUT_POINTS - 1]) {
+        return MOTOR_DUTY_MAX;
+    }
+    if (target <= speed[0]) {
+        return MOTOR_DUTY_MIN;
+    }
+    // interval with speed[k] <= target < speed[k + 1], away from deadband
+    uint32_t k = 0;
+    if (target > 0) {
+        while (speed[k + 1] <= target) {
+            k++;
+        }
+    } else {
+        while (speed[k + 1] < target) {
+            k++;
+        }
+    }
+    // motor starts somewhere inside the interval leaving the deadband, its
+    // edge is where the next interval extended reaches zero speed
+    uint32_t a = k, b = k + 1;
+    if (target > 0 && speed[k] == 0 && k + 2 < MOTOR_LUT_POINTS && speed[k + 2] > speed[k + 1]) {
+        a = k + 1, b = k + 2;
+    } else if (target < 0 && speed[k + 1] == 0 && k > 0 && speed[k - 1] < speed[k]) {
+        a = k - 1, b = k;
+    }
+    float frac = (target - speed[a]) / (speed[b] - speed[a]);
+    float duty_a = motor_lut_point_duty(a);
+    float result = duty_a + frac * (motor_lut_point_duty(b) - duty_a);
+    float lo = motor_lut_point_duty(k), hi = motor_lut_point_duty(k + 1);
+    return result < lo ? lo : result > hi ? hi : result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#define MOTOR_COUNT 2
+#define MOTOR_DUTY_MIN 0.01f
+#define MOTOR_DUTY_MAX 0.99f
+#define MOTOR_DUTY_STOP 0.5f
+
+/* Battery voltage the duty commands are meant for, 2S LiPo */
+#define MOTOR_BATTERY_NOMINAL_V 7.4f
+/* Below - no measurement, duties are not rescaled */
+#define MOTOR_BATTERY_MIN_V 5.0f
+
+/* Sweep points, evenly spaced MOTOR_DUTY_MIN..MOTOR_DUTY_MAX */
+#define MOTOR_LUT_POINTS 17
+#define MOTOR_LUT_VERSION 1
+/* Smaller speed at full duty - motor did not move during sweep [m/s] */
+#define MOTOR_LUT_MIN_SPEED 0.2f
+
+/**
+ * @brief Measured speed of every motor at the sweep duties, stored in NVS as
+ * a blob. motor_lut_prepare() normalizes speeds to the slower motor, so the
+ * same command gives the same speed on both wheels.
+ */
+struct MotorLut {
+    uint32_t version;  // 0 - no table, duty linear
+    float battery_v;   // during sweep
+    float speed[MOTOR_COUNT][MOTOR_LUT_POINTS];
+};
+
+inline float motor_lut_point_duty(uint32_t k) {
+    return MOTOR_DUTY_MIN + k * (MOTOR_DUTY_MAX - MOTOR_DUTY_MIN) / (MOTOR_LUT_POINTS - 1);
+}
+
+bool motor_lut_prepare(MotorLut* lut);
+float motor_lut_duty(const MotorLut& lut, uint32_t motor, float duty, float battery_v);
@@ -4,9 +4,17 @@
 #include "driver/mcpwm_prelude.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "../wifi/nvs_blob.h"
 
 static const char TAG[] = "Motor";
 
+static const char motors_nvs_namespace[] = "motors";
+static const char motors_nvs_key[] = "lut";
+
+/* Used by mcpwm_update_motors(), version 0 - linear */
+static MotorLut motor_lut = {};
+static float battery_v = 0;
+
 #define TIMER_RESOLUTION_HZ 1000000  // 1MHz, 1us per tick
 #define TIMER_PERIOD        1000     // 1000 ticks, 1ms
 #define PWM1_GPIO20           33//20
@@ -154,8 +162,17 @@ void mcpwm_start_motor(float duty) {
     mcpwm_comparator_set_compare_value(comparators[1], 1000 * duty);
 }
 
-/** Update the duty of the motor 0.01f - 0.99f range */
+/**
+ * Update the duty of the motor 0.01f - 0.99f range, duty is speed at nominal
+ * battery voltage, see motor_lut_duty()
+ */
 void mcpwm_update_motors(float dutyA, float dutyB) {
+    mcpwm_update_motors_raw(motor_lut_duty(motor_lut, 0, dutyA, battery_v),
+                            motor_lut_duty(motor_lut, 1, dutyB, battery_v));
+}
+
+/** Duty straight to compare value, no table - for the calibration sweep */
+void mcpwm_update_motors_raw(float dutyA, float dutyB) {
     dutyA = mcpwm_saturation(dutyA);
     dutyB = mcpwm_saturation(dutyB);
 
@@ -171,3 +188,36 @@ void mcpwm_stop_motor() {
     mcpwm_timer_start_stop(timers[0], MCPWM_TIMER_STOP_EMPTY);
     mcpwm_timer_start_stop(timers[1], MCPWM_TIMER_STOP_EMPTY);
 }
+
+/** Battery voltage for the next updates, 0 - not measured */
+void motors_set_battery(float voltage) {
+    battery_v = voltage;
+}
+
+/** Replace the table, from the task calling mcpwm_update_motors() */
+void motors_set_lut(const MotorLut& lut) {
+    motor_lut = lut;
+}
+
+/** Copy for reporting, may be torn by motors_set_lut() */
+MotorLut motors_lut() {
+    return motor_lut;
+}
+
+/** Load table saved by motors_lut_save(), at boot before the motors run */
+bool motors_lut_load() {
+    MotorLut lut;
+    auto err = nvs_blob_load(motors_nvs_namespace, motors_nvs_key, &lut, sizeof(lut));
+    if (err != ESP_OK || lut.version != MOTOR_LUT_VERSION) {
+        ESP_LOGW(TAG, "No motor table in NVS (%s), duty linear", esp_err_to_name(err));
+        return false;
+    }
+    motor_lut = lut;
+    ESP_LOGI(TAG, "Loaded motor table swept at %.2f V", lut.battery_v);
+    return true;
+}
+
+/** Store prepared table, never from the control task */
+esp_err_t motors_lut_save(const MotorLut& lut) {
+    return nvs_blob_save(motors_nvs_namespace, motors_nvs_key, &lut, sizeof(lut));
+}
@@ -1,8 +1,17 @@
 #pragma once
 
 #include "driver/mcpwm_types.h"
+#include "esp_err.h"
+#include "motor_lut.h"
 
 void mcpwm_init();
 void mcpwm_start_motor(float duty);
 void mcpwm_update_motors(float dutyA, float dutyB);
-void mcpwm_stop_motor();
\ No newline at end of file
+void mcpwm_update_motors_raw(float dutyA, float dutyB);
+void mcpwm_stop_motor();
+
+void motors_set_battery(float battery_v);
+void motors_set_lut(const MotorLut& lut);
+MotorLut motors_lut();
+bool motors_lut_load();
+esp_err_t motors_lut_save(const MotorLut& lut);
@@ -0,0 +1,83 @@
+// g++ test_motor_lut.cc motor_lut.cc -o test_motor_lut.e -std=c++17 -O2 -s && ./test_motor_lut.e
+/* Host check of the duty table: deadband, unequal motors, battery voltage */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+#include "motor_lut.h"
+
+using namespace std;
+
+/* Wheel speed of a motor with H-bridge deadband and bent curve */
+struct Motor {
+    float top;       // [m/s] at full duty and nominal voltage
+    float deadband;  // of 2 * duty - 1
+    float bend;      // exponent of the curve above deadband
+
+    float speed(float duty, float battery_v) const {
+        float e = 2 * (duty - MOTOR_DUTY_STOP);
+        float x = max(fabsf(e) - deadband, 0.f) / (1 - deadband);
+        return copysignf(top * battery_v / MOTOR_BATTERY_NOMINAL_V * powf(x, bend), e);
+    }
+};
+
+static const Motor motors[MOTOR_COUNT] = {{3.0f, 0.08f, 0.8f}, {2.7f, 0.12f, 1.2f}};
+
+/* Sweep as motor_calibration.cc, speed averaged from a noisy gyro */
+static MotorLut sweep(float battery_v) {
+    mt19937 rng(1);
+    normal_distribution<float> noise(0, 0.01f);
+    MotorLut lut = {};
+    lut.battery_v = battery_v;
+    for (uint32_t m = 0; m < MOTOR_COUNT; m++) {
+        for (uint32_t k = 0; k < MOTOR_LUT_POINTS; k++) {
+            lut.speed[m][k] = motors[m].speed(motor_lut_point_duty(k), battery_v) + noise(rng);
+        }
+    }
+    return lut;
+}
+
+/* Largest difference of wheel speed from the speed the duty asks for */
+static void check(const char* name, const MotorLut& lut, float battery_v) {
+    // slower motor at nominal voltage is full speed
+    const float top = min(motors[0].top, motors[1].top);
+    float max_err = 0, max_mismatch = 0, low_err = 0;
+    for (float duty = MOTOR_DUTY_STOP - 0.45f; duty <= MOTOR_DUTY_STOP + 0.45f; duty += 0.001f) {
+        float want = 2 * (duty - MOTOR_DUTY_STOP) * top;
+        float v[MOTOR_COUNT];
+        for (uint32_t m = 0; m < MOTOR_COUNT; m++) {
+            v[m] = motors[m].speed(motor_lut_duty(lut, m, duty, battery_v), battery_v);
+            float err = fabsf(v[m] - want);
+            max_err = max(max_err, err);
+            if (fabsf(want) < 0.3f) {
+                low_err = max(low_err, err);
+            }
+        }
+        max_mismatch = max(max_mismatch, fabsf(v[0] - v[1]));
+    }
+    printf("%-14s %.1f V  max err %.3f m/s, below 0.3 m/s %.3f, left - right %.3f\n", name, battery_v,
+           max_err, low_err, max_mismatch);
+}
+
+int main() {
+    const MotorLut linear = {};
+    for (float battery_v : {8.4f, 7.4f, 6.6f}) {
+        check("linear", linear, battery_v);
+    }
+    auto lut = sweep(8.0f);
+    if (!motor_lut_prepare(&lut)) {
+        printf("prepare failed\n");
+        return 1;
+    }
+    for (float battery_v : {8.4f, 7.4f, 6.6f}) {
+        check("table at 8 V", lut, battery_v);
+    }
+    auto stalled = sweep(8.0f);
+    for (auto& v : stalled.speed[1]) {
+        v = 0;
+    }
+    printf("stalled motor rejected: %s\n", motor_lut_prepare(&stalled) ? "no" : "yes");
+    return 0;
+}
@@ -1,9 +1,9 @@
 #include "mpu6500.h"
 #include "registers.h"
 #include "types.h"
+#include "../logging/trace_log.h"
 #include "../utils.h"
 
-#include <driver/i2c.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -14,34 +14,21 @@ static const char TAG[] = "MPU6500";
 
 TaskHandle_t mpu6500_task_handle = NULL;
 
-const float TsACCEL = 0.001f;  // 1kHz
-const float TsGYRO = 0.0029f;  //184 Hz
+/* Full scale ranges set by mpu6500_init(), pivot on one wheel at full speed
+ * turns faster than 1000 dps */
+constexpr auto mpu6500_gyro_fs = GYRO_FS_2000DPS;
+constexpr auto mpu6500_accel_fs = ACCEL_FS_4G;
 
 constexpr auto mpu6500_i2c_num = I2C_NUM_1;
 constexpr uint8_t mpu6500_i2c_address = 0x68;
 constexpr uint32_t mpu6500_timeout_ms = 100;
 
-constexpr i2c_config_t mpu6500_i2c_config = {
-    .mode = I2C_MODE_MASTER,
-    .sda_io_num = 26,
-    .scl_io_num = 27,
-    .sda_pullup_en = GPIO_PULLUP_ENABLE,
-    .scl_pullup_en = GPIO_PULLUP_ENABLE,
-    .master =
-        {
-            .clk_speed = 400000,
-        },
-    .clk_flags = 0, // optional; you can use I2C_SCLK_SRC_FLAG_* flags to choose i2c source clock here
-};
-
-struct mpu6500_calc CalcDataMPU6500;
-
 void mpu6500_init()
 {
     ESP_LOGI(TAG, "Init start!");
 
-    ESP_ERROR_CHECK(i2c_param_config(mpu6500_i2c_num, &mpu6500_i2c_config));
-    ESP_ERROR_CHECK(i2c_driver_install(mpu6500_i2c_num, mpu6500_i2c_config.mode, 0, 0, 0));
+    /* shared with ads7138, installed by whichever starts first */
+    ESP_ERROR_CHECK(i2c_bus_init(mpu6500_i2c_num));
 
     vTaskDelay(pdMS_TO_TICKS(100));
 
@@ -49,10 +36,10 @@ void mpu6500_init()
     mpu6500_set_bits(PWR_MGMT1, PWR1_CLKSEL_BIT, PWR1_CLKSEL_LENGTH, CLOCK_PLL);
 
     // gyroscope set full scale range - 184 Hz bo filtr na w opcji 1
-    mpu6500_set_bits(GYRO_CONFIG, GCONFIG_FS_SEL_BIT, GCONFIG_FS_SEL_LENGTH, GYRO_FS_500DPS);
+    mpu6500_set_bits(GYRO_CONFIG, GCONFIG_FS_SEL_BIT, GCONFIG_FS_SEL_LENGTH, mpu6500_gyro_fs);
 
     // accelerometer - 4G - sampling rate is 1kHz
-    mpu6500_set_bits(ACCEL_CONFIG, ACONFIG_FS_SEL_BIT, ACONFIG_FS_SEL_LENGTH, ACCEL_FS_4G);
+    mpu6500_set_bits(ACCEL_CONFIG, ACONFIG_FS_SEL_BIT, ACONFIG_FS_SEL_LENGTH, mpu6500_accel_fs);
 
     // low pass filter - 188Hz
     mpu6500_set_bits(CONFIG, CONFIG_DLPF_CFG_BIT, CONFIG_DLPF_CFG_LENGTH, DLPF_188HZ);
@@ -65,6 +52,7 @@ void mpu6500_init()
  */
 void mpu6500_test_task(void* pvParameters)
 {
+    trace_log_init();
     mpu6500_init();
 
     struct mpu6500_data data;
@@ -76,18 +64,15 @@ void mpu6500_test_task(void* pvParameters)
 
         data = mpu6500_read_sensors();
 
-        ESP_LOGI(TAG, "Data form ACCEL XYZ: %u, %u, %u ", data.accel_x_be, data.accel_y_be, data.accel_z_be);
-        ESP_LOGI(TAG, "Data form TEMP: %u", data.temp_be);
-        ESP_LOGI(TAG, "Data form GYRO XYZ: %u, %u, %u ", data.gyro_x_be, data.gyro_y_be, data.gyro_z_be);
-
-        /* Recalculate raw data to more complex form */
-        mpu6500_calculate_results(TsACCEL, TsGYRO, data, 0);
+        TRACE_LOGI(TAG, "Data form ACCEL XYZ: %u, %u, %u ", data.accel_x_be, data.accel_y_be, data.accel_z_be);
+        TRACE_LOGI(TAG, "Data form TEMP: %u", data.temp_be);
+        TRACE_LOGI(TAG, "Data form GYRO XYZ: %u, %u, %u ", data.gyro_x_be, data.gyro_y_be, data.gyro_z_be);
 
-        ESP_LOGI(TAG, "SPEED XYZ: %f, %f, %f ", CalcDataMPU6500.speedX, CalcDataMPU6500.speedY, CalcDataMPU6500.speedZ);
-        ESP_LOGI(TAG, "POSITION XYZ: %f, %f, %f ", CalcDataMPU6500.positionX, CalcDataMPU6500.positionY, CalcDataMPU6500.positionZ);
+        TRACE_LOGI(TAG, "ACCEL XYZ [m/s^2]: %f, %f, %f ", mpu6500_accel_to_ms2(data.accel_x_be), mpu6500_accel_to_ms2(data.accel_y_be), mpu6500_accel_to_ms2(data.accel_z_be));
+        TRACE_LOGI(TAG, "GYRO XYZ [rad/s]: %f, %f, %f ", mpu6500_gyro_to_rads(data.gyro_x_be), mpu6500_gyro_to_rads(data.gyro_y_be), mpu6500_gyro_to_rads(data.gyro_z_be));
 
         temperature = mpu6500_temp_to_celsius(data.temp_be);
-        ESP_LOGI(TAG, "Temp %f", temperature);
+        TRACE_LOGI(TAG, "Temp %f", temperature);
     }
 
     vTaskDelete(NULL);
@@ -107,7 +92,7 @@ void mpu6500_set_bits(uint8_t register_address, uint8_t start_bit, uint8_t bit_l
     value &= mask;
 
     uint8_t reg_value = 0;
-    mpu6500_read_data(register_address, &reg_value, 1);
+    mpu6500_read_data(register_address, &reg_value, 1, I2C_BUS_BACKGROUND);
     reg_value = (reg_value & ~mask) | value;
     mpu6500_write_data(register_address, &reg_value, 1);
 }
@@ -121,14 +106,8 @@ void mpu6500_set_bits(uint8_t register_address, uint8_t start_bit, uint8_t bit_l
  */
 void mpu6500_write_data(uint8_t register_address, const uint8_t *data, uint32_t length)
 {
-    auto cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (mpu6500_i2c_address << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, register_address, true);
-    i2c_master_write(cmd, data, length, true);
-    i2c_master_stop(cmd);
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(mpu6500_i2c_num, cmd, pdMS_TO_TICKS(mpu6500_timeout_ms)));
-    i2c_cmd_link_delete(cmd);
+    ESP_ERROR_CHECK(i2c_bus_write(mpu6500_i2c_num, mpu6500_i2c_address, &register_address, 1, data, length,
+                                  mpu6500_timeout_ms, I2C_BUS_BACKGROUND));
 }
 
 /**
@@ -137,19 +116,12 @@ void mpu6500_write_data(uint8_t register_address, const uint8_t *data, uint32_t
  * @param register_address
  * @param data
  * @param length
+ * @param priority I2C_BUS_BACKGROUND outside of the control loop
  */
-void mpu6500_read_data(uint8_t register_address, uint8_t *data, uint32_t length)
+void mpu6500_read_data(uint8_t register_address, uint8_t *data, uint32_t length, I2cBusPriority priority)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (mpu6500_i2c_address << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, register_address, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (mpu6500_i2c_address << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(cmd, data, length, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(mpu6500_i2c_num, cmd, pdMS_TO_TICKS(mpu6500_timeout_ms)));
-    i2c_cmd_link_delete(cmd);
+    ESP_ERROR_CHECK(i2c_bus_read(mpu6500_i2c_num, mpu6500_i2c_address, &register_address, 1, data, length,
+                                 mpu6500_timeout_ms, priority));
 }
 
 mpu6500_data mpu6500_read_sensors() {
@@ -221,26 +193,6 @@ uint16_t mpu6500_read_data_GYRO_Z()
     return ( data << 8  ) | ( data >> 8 );
 }
 
-/**
- * @brief Lets make all necessary calculations here
- *
- * @param tsACCEL
- * @param tsGYRO
- * @param data
- * @param gravityAcc
- */
-void mpu6500_calculate_results(float tsACCEL, float tsGYRO, mpu6500_data& data, uint16_t gravityAcc)
-{
-    CalcDataMPU6500.speedX += tsACCEL * (data.accel_x_be - gravityAcc);
-    CalcDataMPU6500.positionX += tsACCEL * CalcDataMPU6500.speedX;
-
-    CalcDataMPU6500.speedY += tsACCEL * (data.accel_y_be - gravityAcc);
-    CalcDataMPU6500.positionY += tsACCEL * CalcDataMPU6500.speedY;
-
-    CalcDataMPU6500.speedZ += tsACCEL * (data.accel_z_be - gravityAcc);
-    CalcDataMPU6500.positionZ += tsACCEL * CalcDataMPU6500.speedZ;
-}
-
 /**
  * @brief Show celcius temperature
  *
@@ -253,3 +205,25 @@ float mpu6500_temp_to_celsius(uint16_t temp_be) {
 
     return ((float)(swap_bytes(temp_be) - kRoomTempOffset)* kTempResolution + kCelsiusOffset);
 }
+
+/**
+ * @brief Angular rate in rad/s from big endian register value, scaled for
+ * mpu6500_gyro_fs
+ */
+float mpu6500_gyro_to_rads(uint16_t gyro_be) {
+    // 131 LSB/(º/s) at 250 º/s, halves with every range step
+    constexpr static float kRadPerLsb = (1 << mpu6500_gyro_fs) / 131.f * 3.14159265f / 180;
+
+    return (int16_t)swap_bytes(gyro_be) * kRadPerLsb;
+}
+
+/**
+ * @brief Acceleration in m/s^2 from big endian register value, scaled for
+ * mpu6500_accel_fs
+ */
+float mpu6500_accel_to_ms2(uint16_t accel_be) {
+    // 16384 LSB/g at 2 g, halves with every range step
+    constexpr static float kMs2PerLsb = (1 << mpu6500_accel_fs) / 16384.f * 9.80665f;
+
+    return (int16_t)swap_bytes(accel_be) * kMs2PerLsb;
+}
@@ -2,23 +2,23 @@
 
 #include <cstdint>
 
+#include "../i2c_bus/i2c_bus.h"
+
 struct mpu6500_data {
     uint16_t accel_x_be, accel_y_be, accel_z_be;
     uint16_t temp_be;
     uint16_t gyro_x_be, gyro_y_be, gyro_z_be;
 };
 
-struct mpu6500_calc {
-    float positionX, positionY, positionZ;
-    float speedX, speedY, speedZ;
-};
-
 float mpu6500_temp_to_celsius(uint16_t temp_be);
+float mpu6500_gyro_to_rads(uint16_t gyro_be);
+float mpu6500_accel_to_ms2(uint16_t accel_be);
 void mpu6500_init();
 void mpu6500_test_task(void* pvParameters);
 void mpu6500_set_bits(uint8_t register_address, uint8_t start_bit, uint8_t bit_length, uint8_t value);
 void mpu6500_write_data(uint8_t register_address, const uint8_t *data, uint32_t length);
-void mpu6500_read_data(uint8_t register_address, uint8_t *data, uint32_t length);
+void mpu6500_read_data(uint8_t register_address, uint8_t *data, uint32_t length,
+                       I2cBusPriority priority = I2C_BUS_CONTROL);
 mpu6500_data mpu6500_read_sensors();
 uint16_t mpu6500_read_data_ACCEL_X();
 uint16_t mpu6500_read_data_ACCEL_Y();
@@ -27,4 +27,3 @@ uint16_t mpu6500_read_data_TEMP();
 uint16_t mpu6500_read_data_GYRO_X();
 uint16_t mpu6500_read_data_GYRO_Y();
 uint16_t mpu6500_read_data_GYRO_Z();
-void mpu6500_calculate_results(float tsACCEL, float tsGYRO, mpu6500_data& data, uint16_t gravityAcc);
@@ -26,6 +26,7 @@
 
 #include "wifi_manager.h"
 #include "dns_server.h"
+#include "../cores.h"
 
 static const char TAG[] = "dns_server";
 static TaskHandle_t task_dns_server = NULL;
@@ -34,8 +35,9 @@ int socket_fd;
 void dns_server_start()
 {
 	if(task_dns_server == NULL){
-            xTaskCreate(&dns_server, "dns_server", 3072, NULL,
-                        CONFIG_WIFI_MANAGER_TASK_PRIORITY - 1, &task_dns_server);
+            xTaskCreatePinnedToCore(&dns_server, "dns_server", 3072, NULL,
+                        CONFIG_WIFI_MANAGER_TASK_PRIORITY - 1, &task_dns_server,
+                        CORE_SYSTEM);
         }
 }
 
@@ -0,0 +1,66 @@
+/* Struct blobs in NVS under nvs_sync lock */
+#include "nvs_blob.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#include "nvs_sync.h"
+
+static const char TAG[] = "nvs_blob";
+
+/**
+ * @brief Read blob of exactly size bytes, usually at boot before the control
+ * loop, so NVS and nvs_sync may not be initialized yet
+ *
+ * @return ESP_ERR_NVS_INVALID_LENGTH if stored blob has other size
+ */
+esp_err_t nvs_blob_load(
+    const char* name_space, const char* key, void* data, size_t size)
+{
+    nvs_flash_init();  // already done if wifi_manager started first
+    ESP_ERROR_CHECK(nvs_sync_create());
+    if (!nvs_sync_lock(portMAX_DELAY))
+    {
+        ESP_LOGE(TAG, "%s load failed to acquire nvs_sync mutex", key);
+        return ESP_FAIL;
+    }
+    size_t stored_size = size;
+    nvs_handle handle;
+    auto err = nvs_open(name_space, NVS_READONLY, &handle);
+    if (err == ESP_OK)
+    {
+        err = nvs_get_blob(handle, key, data, &stored_size);
+        nvs_close(handle);
+    }
+    nvs_sync_unlock();
+    if (err == ESP_OK && stored_size != size)
+    {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    return err;
+}
+
+esp_err_t nvs_blob_save(
+    const char* name_space, const char* key, const void* data, size_t size)
+{
+    if (!nvs_sync_lock(portMAX_DELAY))
+    {
+        ESP_LOGE(TAG, "%s save failed to acquire nvs_sync mutex", key);
+        return ESP_FAIL;
+    }
+    nvs_handle handle;
+    auto err = nvs_open(name_space, NVS_READWRITE, &handle);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(handle, key, data, size);
+        if (err == ESP_OK)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    nvs_sync_unlock();
+    return err;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <esp_err.h>
+
+#include <cstddef>
+
+/**
+ * Fixed size structs stored as one NVS blob (calibrations, motor table),
+ * every access holds the nvs_sync mutex shared with wifi_manager. Blocking
+ * flash access, never call from the control task.
+ */
+esp_err_t nvs_blob_load(
+    const char* name_space, const char* key, void* data, size_t size);
+esp_err_t nvs_blob_save(
+    const char* name_space, const char* key, const void* data, size_t size);
@@ -12,6 +12,7 @@
 #include "dns_server.h"
 #include "ethernet.h"
 #include "nvs_sync.h"
+#include "../cores.h"
 
 /* objects used to manipulate the main queue of events */
 QueueHandle_t wifi_manager_queue;
@@ -873,13 +874,14 @@ void wifi_manager_start()
 
     /* start wifi manager task */
     ESP_LOGI(TAG, "Wifi task start!");
-    xTaskCreate(
+    xTaskCreatePinnedToCore(
         &wifi_manager_task,
         "wifi_manager",
         4096,
         NULL,
         CONFIG_WIFI_MANAGER_TASK_PRIORITY,
-        &task_wifi_manager);
+        &task_wifi_manager,
+        CORE_SYSTEM);
 }
 
 /**